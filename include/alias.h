@@ -0,0 +1,31 @@
+#ifndef ALIAS_H
+#define ALIAS_H
+#include <stdint.h>
+
+/*
+ * Alias table (Walker, with Vose's construction): draws an index out of
+ * [ 0, n ) following arbitrary weights in O(1), from a single 64-bit
+ * random value. Building the table is O(n).
+ *
+ * The low half of the random value picks a column uniformly, the high
+ * half decides between the column and its alias.
+ */
+
+typedef struct alias_t {
+    int64_t   n;
+    uint32_t *threshold;  /* keep the column when the coin is below it */
+    int64_t  *alias;
+} alias_t;
+
+extern alias_t *alias_create(const double *weights, int64_t n);
+extern void     alias_destroy(alias_t *table);
+
+static inline int64_t alias_sample(const alias_t *table, uint64_t random)
+{
+    int64_t  column = ((random & 0xffffffffULL) * table->n) >> 32;
+    uint32_t coin   = random >> 32;
+
+    return coin < table->threshold[column] ? column : table->alias[column];
+}
+
+#endif /* ALIAS_H */
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <stdint.h>
+#include <stddef.h>
+#include "genfparam.h"
+
+/*
+ * Checkpoint sidecar of --checkpoint, <file>.ckpt next to the file:
+ *
+ *     header      magic, version and the sizes of what follows
+ *     settings    the settings deciding the layout and content, seed
+ *                 included, field by field, and the checkpoint interval
+ *     durable     file offset below which the file is on disk
+ *     state       where the range writer stands at <durable>, opaque here
+ *     checksum    fingerprint of all the above
+ *
+ * It is written to a temporary file, synced and renamed over the previous
+ * one, so a crash leaves either checkpoint whole. It only describes this
+ * build: a sidecar of another version or layout is refused.
+ */
+
+#define CHECKPOINT_SUFFIX ".ckpt"
+
+/* <filename>.ckpt, released with free() */
+extern char *checkpoint_path(const char *filename);
+extern int   checkpoint_write(const char *filename, const param_t *param, int64_t durable,
+                              const void *state, size_t state_size);
+/* <param> gets the saved settings and zeroes elsewhere, <state> may be NULL to read them alone */
+extern int   checkpoint_read(const char *filename, param_t *param, int64_t *durable,
+                             void *state, size_t state_size);
+extern int   checkpoint_remove(const char *filename);
+/* take the settings that decide the layout and content of the file from <saved> */
+extern void  checkpoint_restore(param_t *param, const param_t *saved);
+/* the option of the first saved setting <param> does not share with <saved>, NULL if none */
+extern const char *checkpoint_differs(const param_t *param, const param_t *saved);
+
+#endif /* CHECKPOINT_H */
\ No newline at end of file
@@ -2,12 +2,29 @@
 #define CHUNK_H
 #include <stdint.h>
 
+struct chunk_pool_t;
+
 typedef struct chunk_t {
     int64_t size;
     char *data;
+    struct chunk_pool_t *pool;
 } chunk_t;
 
-extern chunk_t *chunk_create(int64_t size);
+/* a chunk holding bytes [ offset, offset+size ) of the content stream <key> at compression <ratio> */
+extern chunk_t *chunk_create(int64_t size, uint64_t key, double ratio, int64_t offset);
 extern void     chunk_destroy(chunk_t *chunk);
 
+/*
+ * A fixed set of pre-faulted chunk buffers of up to <max_size> bytes each.
+ * chunk_pool_get() refills a free buffer in place instead of allocating,
+ * and chunk_destroy() hands it back. A pool is not thread-safe: keep one
+ * per thread.
+ */
+typedef struct chunk_pool_t chunk_pool_t;
+
+extern chunk_pool_t *chunk_pool_create(int64_t max_size, int num_chunks);
+extern chunk_t      *chunk_pool_get(chunk_pool_t *pool, int64_t size, uint64_t key, double ratio, int64_t offset);
+extern uint64_t      chunk_pool_allocs_avoided(chunk_pool_t *pool);
+extern void          chunk_pool_destroy(chunk_pool_t *pool);
+
 #endif /* CHUNK_H */
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef CHUNKDICT_H
+#define CHUNKDICT_H
+#include <stdint.h>
+#include "genfparam.h"
+
+/*
+ * Shared chunk dictionary: a persistent pool file of <num_chunks> base
+ * chunks of <chunk_size> bytes that several runs, or the lines of a
+ * manifest, draw chunks from, so the files they generate share content
+ * with each other.
+ *
+ *     page 0:  "dfgen-dict v1 chunk-size <n> chunks <n> seed <n>"
+ *     page 1+: chunk 0, chunk 1, ...
+ *
+ * The pool is created by the first run that needs it and mapped read-only
+ * by everyone else, so concurrent generators share its pages through the
+ * page cache. Chunk <i> lives at a fixed offset of the mapping.
+ */
+
+#define CHUNK_DICT_HEADER_SIZE 4096
+
+typedef struct chunk_dict_t {
+    int      fd;
+    char    *map;
+    int64_t  map_size;
+    int64_t  chunk_size;
+    int64_t  num_chunks;
+    uint64_t seed;
+} chunk_dict_t;
+
+/* map the pool at <param->dict_path>, or create it with the settings of <param> if missing and <create> */
+extern chunk_dict_t *chunk_dict_open(param_t *param, int create);
+extern void          chunk_dict_close(chunk_dict_t *dict);
+
+/* content of chunk <idx> */
+static inline const char *chunk_dict_get(const chunk_dict_t *dict, int64_t idx)
+{
+    return dict->map + CHUNK_DICT_HEADER_SIZE + idx * dict->chunk_size;
+}
+
+#endif /* CHUNKDICT_H */
\ No newline at end of file
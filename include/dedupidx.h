@@ -0,0 +1,50 @@
+#ifndef DEDUPIDX_H
+#define DEDUPIDX_H
+#include <stdint.h>
+#include "genfparam.h"
+
+/*
+ * Ground-truth dedup index, a text sidecar written while the file is being
+ * generated:
+ *
+ *     # dfgen dedup index v1
+ *     # <settings of the run>
+ *     # offset          length           kind fingerprint
+ *     0000000000000000 0000000000065536 F    6f1c0a5e92d3b874
+ *     ...
+ *     # summary: <totals, unique bytes and expected dedup ratio>
+ *
+ * Every record line has the same width, so record <n> lives at a known
+ * offset and workers can write theirs in any order.
+ */
+
+enum DEDUP_KIND {
+    DEDUP_KIND_FIXED     = 'F',
+    DEDUP_KIND_NON_FIXED = 'N',
+    DEDUP_KIND_HOLE      = 'H',
+    DEDUP_KIND_DICT      = 'D',  /* non-fixed chunk copied from the chunk dictionary */
+};
+
+typedef struct dedup_record_t {
+    int64_t  offset;
+    int64_t  length;
+    int      kind;
+    uint64_t fingerprint;
+} dedup_record_t;
+
+typedef struct dedup_summary_t {
+    int64_t  num_chunks;
+    int64_t  num_holes;
+    int64_t  data_bytes;
+    int64_t  hole_bytes;
+    int64_t  unique_bytes;
+} dedup_summary_t;
+
+typedef struct dedup_index_t dedup_index_t;
+
+extern dedup_index_t *dedup_index_create(const char *path, param_t *param);
+extern int            dedup_index_write(dedup_index_t *idx, int64_t first, const dedup_record_t *records, int num_records);
+extern int            dedup_index_finish(dedup_index_t *idx, int64_t num_records, const dedup_summary_t *summary);
+extern void           dedup_index_destroy(dedup_index_t *idx);
+
+#endif /* DEDUPIDX_H */
\ No newline at end of file
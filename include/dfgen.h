@@ -0,0 +1,81 @@
+#ifndef DFGEN_H
+#define DFGEN_H
+#include <stdint.h>
+#include "genfparam.h"
+
+/*
+ * libdfgen: the generator behind the dfgen command, for programs that want
+ * the generated file in process instead of on disk.
+ *
+ * A handle is created from a param_t (start from dfgen_param_init() and
+ * set what the command line options would), pointed at an output and run:
+ *
+ *     param_t param;
+ *     dfgen_param_init(&param);
+ *     param.filesize = 64 * 1024 * 1024;
+ *     param.seed     = 42;
+ *
+ *     dfgen_t *gen = dfgen_create(&param);
+ *     dfgen_set_callback(gen, consume, arg);
+ *     dfgen_run(gen);
+ *     dfgen_destroy(gen);
+ *
+ * Without an output, the file named by param.filename is written, like the
+ * command does. The layout and content do not depend on the output: the
+ * same settings and seed always produce the same bytes.
+ *
+ * Handles are independent and may run concurrently, each with its own
+ * --compress-ratio. Only the content engine (-E) is process-wide: it never
+ * changes the bytes, just the speed they are generated at.
+ */
+
+/* what a range of the file holds */
+enum DFGEN_KIND {
+    DFGEN_KIND_FIXED     = 0,
+    DFGEN_KIND_NON_FIXED = 1,
+    DFGEN_KIND_HOLE      = 2,
+};
+
+/*
+ * Gets [ offset, offset + length ) of the file, <buf> being NULL for a
+ * hole. Ranges come in no particular order, and from -t threads at once.
+ * <buf> is only valid during the call. Anything but 0 stops the run.
+ */
+typedef int (*dfgen_callback_t)(void *arg, const void *buf, int64_t offset, int64_t length, int kind);
+
+typedef struct dfgen_t dfgen_t;
+
+/* defaults of every setting, and a seed derived from the clock */
+extern void     dfgen_param_init(param_t *param);
+/* report the invalid settings on stderr, and return how many there are */
+extern int      dfgen_param_check(const param_t *param);
+/*
+ * Before checking them: take the seed and the settings that decide the
+ * layout of param.filename from its checkpoint, to carry on an interrupted
+ * generation with param.resume set.
+ */
+extern int      dfgen_param_resume(param_t *param);
+/* derive the sizes of the fixed and non-fixed parts, and the implied settings */
+extern int      dfgen_param_prepare(param_t *param);
+
+/* the handle keeps a copy of <param>, whose strings must outlive it */
+extern dfgen_t *dfgen_create(const param_t *param);
+extern void     dfgen_destroy(dfgen_t *gen);
+
+/* hand every range to <callback>, straight from the generator buffers */
+extern int      dfgen_set_callback(dfgen_t *gen, dfgen_callback_t callback, void *arg);
+/* generate into <buffer>, which must hold dfgen_max_size() bytes */
+extern int      dfgen_set_buffer(dfgen_t *gen, void *buffer, int64_t size);
+/* generate into an anonymous memory file, see dfgen_memfd() */
+extern int      dfgen_set_memfd(dfgen_t *gen);
+
+/* size of the file with every hole, an upper bound of what dfgen_run() returns */
+extern int64_t  dfgen_max_size(const dfgen_t *gen);
+/* generate the file, and return its size (holes included) or -1 */
+extern int64_t  dfgen_run(dfgen_t *gen);
+/* check param.filename against the content the settings generate */
+extern int      dfgen_verify(dfgen_t *gen);
+/* the memory file after dfgen_run(), owned by the handle: dup() it to keep it */
+extern int      dfgen_memfd(const dfgen_t *gen);
+
+#endif /* DFGEN_H */
\ No newline at end of file
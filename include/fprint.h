@@ -0,0 +1,30 @@
+#ifndef FPRINT_H
+#define FPRINT_H
+#include <stdint.h>
+
+/*
+ * 64-bit chunk fingerprint: two interleaved CRC32C lanes over the chunk,
+ * computed with the SSE4.2 crc32 instruction when the CPU has it and with a
+ * table otherwise. Both implementations return the same value.
+ *
+ * A chunk too large to be held in memory at once is fingerprinted piece by
+ * piece with fingerprint_begin/update/end, which give the same value as
+ * fingerprint() over the whole chunk.
+ */
+
+#define FPRINT_BLOCK_SIZE 16
+
+typedef struct fingerprint_t {
+    uint32_t      a;
+    uint32_t      b;
+    unsigned char tail[FPRINT_BLOCK_SIZE];
+    int           tail_len;
+} fingerprint_t;
+
+extern uint64_t    fingerprint(const void *buf, int64_t len);
+extern void        fingerprint_begin(fingerprint_t *fp, int64_t length);
+extern void        fingerprint_update(fingerprint_t *fp, const void *buf, int64_t len);
+extern uint64_t    fingerprint_end(fingerprint_t *fp);
+extern const char *fingerprint_name(void);
+
+#endif /* FPRINT_H */
\ No newline at end of file
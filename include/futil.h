@@ -1,4 +1,22 @@
 #ifndef FUTIL_H
 #define FUTIL_H
+#include <stdint.h>
+
+/* default alignment of O_DIRECT buffers, offsets and lengths */
+#define FUTIL_DIRECT_ALIGNMENT 4096
+/* most bytes Linux moves in one read/write call (MAX_RW_COUNT) */
+#define FUTIL_MAX_RW_SIZE      0x7ffff000LL
+
+/* flags of pwrite_repeat() */
+#define FUTIL_REPEAT_COPY      0x1 /* duplicate what is written with copy_file_range() */
+
+extern int   pwrite_full(int fd, const void *buf, int64_t len, int64_t offset);
+extern int   pwrite_repeat(int fd, const void *buf, int64_t period, int64_t skew, int64_t len, int64_t offset,
+                           int flags);
+extern void *alloc_aligned(int64_t size, int64_t alignment);
+extern int   prealloc_range(int fd, int64_t offset, int64_t len);
+extern int   sync_behind(int fd, int64_t offset, int64_t len, int64_t prev_offset, int64_t prev_len);
+extern int   sync_path(const char *path);
+extern int   drop_cache_path(const char *path);
 
 #endif /* FUTIL_H */
\ No newline at end of file
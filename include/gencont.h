@@ -1,4 +1,61 @@
 #ifndef GENCONT_H
 #define GENCONT_H
+#include <stdint.h>
 
-#endif /* GENCONT_H */
\ No newline at end of file
+/*
+ * Content engine.
+ *
+ * Two generators live here:
+ *
+ *   - prng_t, a small sequential xoshiro256** generator, used wherever a
+ *     stream of decisions is needed (chunk sizes, hole positions, ...).
+ *
+ *   - gencont_fill(), a counter-based generator: the content of any byte is
+ *     a pure function of (key, ratio, offset), so disjoint ranges can be generated
+ *     independently, in any order, by any thread. It comes in several
+ *     implementations (scalar, SSE4.1, AVX2) producing identical bytes; the
+ *     fastest one supported by the CPU is selected at runtime.
+ *
+ * Keys are derived from the run seed with gencont_derive(), one per stream.
+ */
+
+enum GENCONT_STREAM {
+    GENCONT_STREAM_FIXED      = 1,
+    GENCONT_STREAM_NON_FIXED  = 2,
+    GENCONT_STREAM_CHUNK_SIZE = 3,
+    GENCONT_STREAM_HOLES      = 4,
+    GENCONT_STREAM_DICT       = 5,
+    GENCONT_STREAM_DICT_PICKS = 6,
+    GENCONT_STREAM_PATTERNS   = 7,
+    GENCONT_STREAM_TREE_SIZES = 8,
+    GENCONT_STREAM_TREE_FILES = 9,
+    GENCONT_STREAM_MUTATE     = 10,
+};
+
+typedef struct prng_t {
+    uint64_t s[4];
+} prng_t;
+
+extern void        prng_seed(prng_t *prng, uint64_t seed);
+extern uint64_t    prng_next(prng_t *prng);
+extern uint64_t    prng_bounded(prng_t *prng, uint64_t range);
+
+/* size of the next variable-length chunk, uniform in [ min, max ) */
+static inline int64_t random_chunk_size(prng_t *prng, int64_t min, int64_t max)
+{
+    if (max == min)
+        return max;
+    return min + prng_bounded(prng, max-min);
+}
+
+extern uint64_t    gencont_derive(uint64_t seed, uint64_t stream);
+extern uint64_t    gencont_hash64(uint64_t key, uint64_t counter);
+
+extern int         gencont_supported(const char *name);
+extern int         gencont_select(const char *name);
+extern const char *gencont_name(void);
+
+/* the content compresses about <ratio> times, 1.0 for incompressible content */
+extern void        gencont_fill(uint64_t key, double ratio, int64_t offset, void *buf, int64_t len);
+
+#endif /* GENCONT_H */
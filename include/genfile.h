@@ -3,5 +3,6 @@
 #include "genfparam.h"
 
 extern int generate_file(param_t *param);
+extern int verify_file(param_t *param);
 
 #endif /* GENFILE_H */
\ No newline at end of file
@@ -1,6 +1,51 @@
 #ifndef GENFPARAM_H
 #define GENFPARAM_H
 #include "stdint.h"
+#include <string.h>
+
+/* -f - streams the generating file to stdout */
+#define PARAM_STREAM_FILENAME "-"
+
+/* largest fixed or variable-size chunk */
+#define PARAM_MAX_CHUNK_SIZE    (1024LL * 1024 * 1024)
+/* buffers of the generating file, when --mem-limit is not given */
+#define PARAM_DEFAULT_MEM_LIMIT (512LL * 1024 * 1024)
+
+/* popularity of the fixed patterns */
+enum PATTERN_DIST {
+    PATTERN_DIST_UNIFORM = 0,
+    PATTERN_DIST_ZIPF    = 1,
+    PATTERN_DIST_HOTCOLD = 2,
+    PATTERN_DIST_LAST,
+};
+
+struct sink_output_t;
+
+/* edits of --mutate */
+enum EDIT_KIND {
+    EDIT_KIND_OVERWRITE = 0,
+    EDIT_KIND_INSERT    = 1,
+    EDIT_KIND_DELETE    = 2,
+    EDIT_KIND_APPEND    = 3,
+    EDIT_KIND_TRUNCATE  = 4,
+    EDIT_KIND_LAST,
+};
+
+/* shape of the --rate over time */
+enum RATE_PROFILE {
+    RATE_PROFILE_CONSTANT = 0,
+    RATE_PROFILE_SQUARE   = 1,  /* --rate and rate_low % of it, half a period each */
+    RATE_PROFILE_RAMP     = 2,  /* from 0 up to --rate over a period, then --rate */
+    RATE_PROFILE_LAST,
+};
+
+/* durability of the generated file, --sync */
+enum SYNC_MODE {
+    SYNC_MODE_NONE  = 0,
+    SYNC_MODE_END   = 1,    /* fdatasync() once written */
+    SYNC_MODE_EVERY = 2,    /* write-behind every sync_every bytes, then as SYNC_MODE_END */
+    SYNC_MODE_LAST,
+};
 
 typedef struct param_t {
     char    *filename;
@@ -14,8 +59,59 @@ typedef struct param_t {
     int64_t  chunk_size_max;
     int      quiet;
     int      enable_holes;
-    int      num_holes;
+    int64_t  num_holes;
     int64_t  holes_size;
+    int      threads;
+    uint64_t seed;
+    int      direct;
+    int      async;
+    int      queue_depth;
+    char    *manifest;
+    char    *index_path;
+    int      skip_holes;
+    int      verify;
+    int      mmap;
+    char    *stats_json;
+    int64_t  mem_limit;
+    char    *dict_path;
+    int64_t  dict_chunks;
+    int      overlap;
+    double   compress_ratio;
+    int64_t  fixed_patterns;
+    int      pattern_dist;
+    double   pattern_skew;
+    int      hot_ratio;
+    int      hot_traffic;
+    int      copy_range;
+    char    *tree_path;
+    int64_t  tree_files;
+    int      tree_fanout;
+    int      tree_dir_files;
+    int64_t  file_size_min;
+    int64_t  file_size_max;
+    char    *mutate_path;
+    char    *mutate_out;
+    double   change_ratio;          /* percentage of the file the edits touch */
+    int64_t  num_edits;
+    int      edit_mix[EDIT_KIND_LAST];
+    int64_t  rate;                  /* bytes per second, 0 = as fast as possible */
+    int      rate_profile;
+    double   rate_period;           /* seconds */
+    double   rate_low;              /* percentage of the rate */
+    double   duration;              /* seconds, 0 = no deadline */
+    int64_t  loops;                 /* passes over the file, 0 = one, or as many as --duration allows */
+    int      prealloc;
+    int      sync_mode;
+    int64_t  sync_every;
+    int      drop_cache;
+    int64_t  checkpoint_interval;   /* bytes between checkpoints, 0 = none */
+    int      resume;
+    struct sink_output_t *output; /* set by the library to generate in memory, see dfgen.h */
 } param_t;
 
+static inline int param_is_stream(const param_t *param)
+{
+    return param->filename && strcmp(param->filename, PARAM_STREAM_FILENAME) == 0;
+}
+
 #endif /* GENFPARAM_H */
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef GENTREE_H
+#define GENTREE_H
+#include "genfparam.h"
+
+/*
+ * Tree mode: --tree-files small files spread over a directory hierarchy
+ * under --tree, every file laid out like a file of its own (fixed part,
+ * then non-fixed part) with a seed derived from --seed and its number.
+ */
+extern int generate_tree(param_t *param);
+
+/* size and seed of file <index> of the tree */
+extern int64_t  tree_file_size(const param_t *param, int64_t index);
+extern uint64_t tree_file_seed(const param_t *param, int64_t index);
+
+#endif /* GENTREE_H */
\ No newline at end of file
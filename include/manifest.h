@@ -0,0 +1,14 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+#include "genfparam.h"
+
+/*
+ * Batch mode: every non-empty line of a manifest holds the command line
+ * options of one file to generate. <parse> turns such an argument vector
+ * into a ready to use param_t, starting from a copy of <defaults>.
+ */
+typedef int (*manifest_parse_fn)(param_t *param, int argc, char **argv);
+
+extern int run_manifest(const char *path, param_t *defaults, manifest_parse_fn parse);
+
+#endif /* MANIFEST_H */
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef MUTATE_H
+#define MUTATE_H
+#include "genfparam.h"
+
+/*
+ * Mutation mode: derive the next generation of an existing file by
+ * applying a seeded edit script to it, in place or to a reflinked copy,
+ * so that the I/O follows the size of the change rather than of the file.
+ */
+extern int mutate_file(param_t *param);
+
+#endif /* MUTATE_H */
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef RATE_H
+#define RATE_H
+#include <stdint.h>
+#include "genfparam.h"
+
+/*
+ * Write pacing for --rate and --duration.
+ *
+ * The profile gives the bytes due since the start, A(t): --rate bytes per
+ * second, held constant, alternating with a lower rate (square) or climbing
+ * from 0 (ramp). Writers reserve their bytes in order and sleep until the
+ * first of them is due, so the rate holds whatever the number of workers
+ * and drifts by no more than a clock_nanosleep() overshoot. Credit left
+ * unused by writers that fall behind is kept up to a bucket of
+ * RATE_BURST_MS worth of bytes; the rest is lost, as a shortfall, rather
+ * than written in a burst later.
+ *
+ * Without --rate nothing is paced and only the --duration deadline counts.
+ */
+
+/* how far writers may catch up at once, in milliseconds of the target rate */
+#define RATE_BURST_MS 10
+
+typedef struct rate_t rate_t;
+
+extern rate_t *rate_create(const param_t *param);
+/* 0 once <bytes> may be written, 1 when the run is over by then */
+extern int     rate_pace(rate_t *rate, int64_t bytes);
+extern int     rate_expired(rate_t *rate);
+/* bytes due from the start to <now> (stats_now() clock), 0 when unpaced */
+extern double  rate_due(rate_t *rate, uint64_t now);
+extern int64_t rate_shortfall(rate_t *rate);
+extern void    rate_destroy(rate_t *rate);
+
+#endif /* RATE_H */
\ No newline at end of file
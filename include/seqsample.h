@@ -0,0 +1,30 @@
+#ifndef SEQSAMPLE_H
+#define SEQSAMPLE_H
+#include <stdint.h>
+#include "gencont.h"
+
+/*
+ * Sequential random sampling: draws <n> distinct indices out of [ 0, N )
+ * uniformly, returning them one at a time in increasing order. Nothing is
+ * stored and nothing is sorted, so n can be in the millions.
+ *
+ * This is Vitter's Method D ("An Efficient Algorithm for Sequential Random
+ * Sampling", 1987): O(n) expected time whatever N is. When n gets large
+ * compared to what remains of N it switches to Method A, which is cheaper
+ * there.
+ */
+
+typedef struct seqsample_t {
+    prng_t   prng;
+    int64_t  n;          /* indices still to select */
+    int64_t  N;          /* indices still to consider */
+    int64_t  position;   /* index of the next candidate */
+    double   vprime;
+    int      method_a;
+} seqsample_t;
+
+extern void    seqsample_init(seqsample_t *sample, uint64_t seed, int64_t n, int64_t N);
+/* the next selected index, or -1 once all <n> have been returned */
+extern int64_t seqsample_next(seqsample_t *sample);
+
+#endif /* SEQSAMPLE_H */
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef SINK_H
+#define SINK_H
+#include <stdint.h>
+#include "genfparam.h"
+#include "dfgen.h"
+
+/*
+ * Output backends of the range writer.
+ *
+ * Every worker asks the sink for a buffer covering the file range it is about
+ * to produce (sink_acquire), fills it, and hands it back (sink_commit). The
+ * sink decides where that buffer lives and how it reaches the file, so the
+ * content generation code does not depend on the I/O method.
+ */
+
+enum SINK_TYPE {
+    SINK_TYPE_PWRITE   = 0,
+    SINK_TYPE_DIRECT   = 1,
+    SINK_TYPE_ASYNC    = 2,
+    SINK_TYPE_STREAM   = 3,
+    SINK_TYPE_MMAP     = 4,
+    SINK_TYPE_CALLBACK = 5,
+    SINK_TYPE_BUFFER   = 6,
+    SINK_TYPE_MEMFD    = 7,
+    SINK_TYPE_LAST,
+};
+
+/*
+ * Where the library (dfgen.h) wants the file, through param->output. The
+ * in-memory sinks take their target from here, and the size of the file
+ * is handed back in <size> whatever the sink.
+ */
+typedef struct sink_output_t {
+    int              type;          /* SINK_TYPE_CALLBACK, _BUFFER or _MEMFD, -1 for the file */
+    dfgen_callback_t callback;
+    void            *arg;
+    char            *buffer;
+    int64_t          buffer_size;
+    int              memfd;         /* left open by the memfd sink */
+    int64_t          size;
+} sink_output_t;
+
+typedef struct sink_t sink_t;
+typedef struct sink_writeback_t sink_writeback_t;
+
+typedef struct sink_ops_t {
+    const char *name;
+    int       (*open)(sink_t *sink);
+    void     *(*acquire)(sink_t *sink, int worker, int64_t offset, int64_t length);
+    int       (*commit)(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length);
+    int       (*write)(sink_t *sink, int worker, const void *buf, int64_t offset, int64_t length);
+    int       (*close)(sink_t *sink, int64_t total_size);
+    /* a worker starts on a range of <kind> (DFGEN_KIND_*), for sinks that tell them apart */
+    void      (*begin)(sink_t *sink, int worker, int kind);
+    /* [ offset, offset + length ) is a hole, nothing to do when not set */
+    int       (*hole)(sink_t *sink, int64_t offset, int64_t length);
+    /* write the repetition of a buffer, see sink_repeat(), with sink_write() when not set */
+    int       (*repeat)(sink_t *sink, int worker, const void *buf, int64_t period, int64_t skew,
+                        int64_t offset, int64_t length);
+    /* buffers of buffer_size the sink allocates, one per worker when not set */
+    int       (*num_buffers)(param_t *param, int num_workers);
+} sink_ops_t;
+
+struct sink_t {
+    const sink_ops_t *ops;
+    param_t          *param;
+    int               num_workers;
+    int64_t           buffer_size;
+    int               fd;
+    char            **buffers;
+    void             *priv;
+    sink_writeback_t *writeback;    /* per worker, with --sync every:<size> on a regular file */
+};
+
+extern sink_t *sink_create(int type, param_t *param, int num_workers, int64_t buffer_size);
+extern int     sink_num_buffers(int type, param_t *param, int num_workers);
+extern void   *sink_acquire(sink_t *sink, int worker, int64_t offset, int64_t length);
+extern int     sink_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length);
+extern int     sink_write(sink_t *sink, int worker, const void *buf, int64_t offset, int64_t length);
+extern int     sink_repeat(sink_t *sink, int worker, const void *buf, int64_t period, int64_t skew,
+                           int64_t offset, int64_t length);
+extern void    sink_begin(sink_t *sink, int worker, int kind);
+extern int     sink_hole(sink_t *sink, int64_t offset, int64_t length);
+extern int     sink_destroy(sink_t *sink, int64_t total_size);
+
+/* for backends: O_CREAT, and O_TRUNC unless a --resume carries on with what the file holds */
+extern int     sink_create_flags(const param_t *param);
+/* for backends: extend the file to <total_size> (unless negative) and close it */
+extern int     sink_close_fd(sink_t *sink, int64_t total_size);
+/* for backends: per-worker buffers of buffer_size, allocated by sink_create() */
+extern void   *sink_default_acquire(sink_t *sink, int worker, int64_t offset, int64_t length);
+
+extern const sink_ops_t sink_async_ops;
+extern const sink_ops_t sink_stream_ops;
+extern const sink_ops_t sink_mmap_ops;
+extern const sink_ops_t sink_callback_ops;
+extern const sink_ops_t sink_buffer_ops;
+extern const sink_ops_t sink_memfd_ops;
+
+#endif /* SINK_H */
\ No newline at end of file
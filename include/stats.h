@@ -0,0 +1,55 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stdint.h>
+#include <time.h>
+#include "genfparam.h"
+#include "rate.h"
+
+/*
+ * Run telemetry.
+ *
+ * Every worker owns a cache line of counters and is the only one writing
+ * it, so the hot path takes no lock: bytes and chunks produced, the time
+ * spent generating content, in write calls and in flushing, and a log2
+ * histogram of the write latencies. A reporter thread samples the counters
+ * periodically and prints progress; the totals make the final report.
+ * With --rate, every interval is also held against the bytes the rate
+ * profile made due in it, and the intervals falling short are counted.
+ *
+ * All functions accept a NULL stats_t and then do nothing.
+ */
+
+/* the last three are spent by the main thread alone, before and after the workers run */
+enum STATS_PHASE {
+    STATS_PHASE_GENERATE   = 0,
+    STATS_PHASE_WRITE      = 1,
+    STATS_PHASE_SYNC       = 2,
+    STATS_PHASE_PREALLOC   = 3,
+    STATS_PHASE_DROP_CACHE = 4,
+    STATS_PHASE_LAST,
+};
+
+/* latency bucket <k> counts the writes taking [ 2^k, 2^(k+1) ) ns */
+#define STATS_LATENCY_BUCKETS 48
+
+typedef struct stats_t stats_t;
+
+static inline uint64_t stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* <interval_ms> = 0 runs no reporter */
+extern stats_t *stats_create(param_t *param, int num_workers, int interval_ms);
+extern void     stats_set_rate(stats_t *stats, rate_t *rate);
+extern void     stats_add_data(stats_t *stats, int worker, int64_t bytes, int64_t chunks);
+extern void     stats_add_time(stats_t *stats, int worker, int phase, uint64_t ns);
+extern void     stats_add_write(stats_t *stats, int worker, uint64_t ns);
+extern void     stats_finish(stats_t *stats);
+extern void     stats_print(stats_t *stats);
+extern int      stats_write_json(stats_t *stats, const char *path);
+extern void     stats_destroy(stats_t *stats);
+
+#endif /* STATS_H */
\ No newline at end of file
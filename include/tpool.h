@@ -0,0 +1,25 @@
+#ifndef TPOOL_H
+#define TPOOL_H
+
+/*
+ * A minimal fixed-size worker pool with a bounded job queue.
+ *
+ * Jobs are executed as fn(arg, worker) where worker is the index
+ * [ 0 - num_threads ) of the thread running the job, so callers can
+ * keep per-worker state (buffers, random states) without locking.
+ *
+ * A pool created with num_threads <= 1 spawns no thread at all, and
+ * tpool_submit() runs the job inline in the caller as worker 0.
+ */
+
+typedef void (*tpool_fn_t)(void *arg, int worker);
+
+typedef struct tpool_t tpool_t;
+
+extern tpool_t *tpool_create(int num_threads, int queue_depth);
+extern int      tpool_submit(tpool_t *pool, tpool_fn_t fn, void *arg);
+extern void     tpool_wait(tpool_t *pool);
+extern void     tpool_destroy(tpool_t *pool);
+extern int      tpool_num_workers(tpool_t *pool);
+
+#endif /* TPOOL_H */
@@ -3,6 +3,7 @@
 GEN_DIR="dummy_collections"
 GEN_ROOT="$HOME/Desktop/$GEN_DIR"
 EXEC_PATH="../bin/dfgen"
+MANIFEST="$GEN_ROOT/manifest.txt"
 
 FILENAME_PREFIX="dummy"
 FILENAME_EXTENSION="tmp"
@@ -22,12 +23,12 @@ for i in "${ratios[@]}"; do
     mkdir $tmp
 done
 
-# creating files
+# list every file in a manifest
 for ratio in "${ratios[@]}"; do
     for size in "${sizes[@]}"; do
-        $EXEC_PATH -f "$GEN_ROOT"/"$ratio"/"$FILENAME_PREFIX"_"$ratio"_"$size"."$FILENAME_EXTENSION" -s "$size" -r "$ratio"
+        echo "-f \"$GEN_ROOT/$ratio/${FILENAME_PREFIX}_${ratio}_${size}.$FILENAME_EXTENSION\" -s $size -r $ratio"
     done
-done
-
-
+done > "$MANIFEST"
 
+# creating files, every file gets its own seed derived from the master seed
+$EXEC_PATH --manifest "$MANIFEST" -t "$(nproc)" --seed "${SEED:-$RANDOM}"
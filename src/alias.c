@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <errno.h>
+#include "alias.h"
+
+/* 2^32: a column kept with probability 1 never reaches its alias */
+#define ALIAS_ONE 4294967296.0
+
+alias_t *alias_create(const double *weights, int64_t n)
+{
+    double total = 0;
+
+    if (!weights || n <= 0 || n > UINT32_MAX) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    for (int64_t i = 0 ; i < n; i++) {
+        if (!(weights[i] >= 0)) {
+            errno = EINVAL;
+            return NULL;
+        }
+        total += weights[i];
+    }
+    if (!(total > 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    alias_t *table  = calloc(1, sizeof(alias_t));
+    double  *scaled = malloc(n * sizeof(double));
+    int64_t *small  = malloc(n * sizeof(int64_t));
+    int64_t *large  = malloc(n * sizeof(int64_t));
+    int64_t  num_small = 0, num_large = 0;
+
+    if (!table || !scaled || !small || !large)
+        goto error;
+
+    table->n         = n;
+    table->threshold = malloc(n * sizeof(uint32_t));
+    table->alias     = malloc(n * sizeof(int64_t));
+    if (!table->threshold || !table->alias)
+        goto error;
+
+    /* columns under the mean lend their free room to columns over it */
+    for (int64_t i = 0 ; i < n; i++) {
+        scaled[i] = weights[i] * n / total;
+        if (scaled[i] < 1.0)
+            small[num_small++] = i;
+        else
+            large[num_large++] = i;
+    }
+
+    while (num_small > 0 && num_large > 0) {
+        int64_t s = small[--num_small];
+        int64_t l = large[--num_large];
+
+        table->threshold[s] = (uint32_t)(scaled[s] * ALIAS_ONE);
+        table->alias[s]     = l;
+
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0)
+            small[num_small++] = l;
+        else
+            large[num_large++] = l;
+    }
+
+    /* whatever is left is full, up to rounding errors */
+    while (num_large > 0) {
+        int64_t l = large[--num_large];
+        table->threshold[l] = UINT32_MAX;
+        table->alias[l]     = l;
+    }
+    while (num_small > 0) {
+        int64_t s = small[--num_small];
+        table->threshold[s] = UINT32_MAX;
+        table->alias[s]     = s;
+    }
+
+    free(scaled);
+    free(small);
+    free(large);
+    return table;
+
+error:
+    free(scaled);
+    free(small);
+    free(large);
+    alias_destroy(table);
+    errno = ENOMEM;
+    return NULL;
+}
+
+void alias_destroy(alias_t *table)
+{
+    if (!table)
+        return;
+
+    free(table->threshold);
+    free(table->alias);
+    free(table);
+}
\ No newline at end of file
@@ -0,0 +1,604 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "chunk.h"
+#include "futil.h"
+#include "gencont.h"
+#include "genfile.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+/*
+ * dfgen-bench - micro-benchmarks of the generator stages.
+ *
+ * Every case runs <warmup> untimed trials and then <trials> timed ones. A
+ * trial processes a fixed amount of work, so the per-trial wall time and
+ * TSC ticks can be compared between builds. Results are printed one line
+ * per case, as CSV or JSON lines, each naming the compiler and the flags
+ * the suite was built with.
+ */
+
+#define BENCH_DEFAULT_WARMUP 2
+#define BENCH_DEFAULT_TRIALS 10
+#define BENCH_DEFAULT_DIR    "/dev/shm"
+
+#define BENCH_BUFFER_SIZE    (4LL * 1024 * 1024)  /* one range writer unit */
+#define BENCH_FILL_BYTES     (64LL * 1024 * 1024)
+#define BENCH_WRITE_BYTES    (64LL * 1024 * 1024)
+#define BENCH_CHUNK_SIZE     65536
+#define BENCH_CHUNK_OPS      1024
+#define BENCH_SAMPLE_OPS     (1024 * 1024)
+#define BENCH_SEED           0x6466676562656e63ULL
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS         "unknown"
+#endif
+
+#ifdef __VERSION__
+#define BENCH_COMPILER       __VERSION__
+#else
+#define BENCH_COMPILER       "unknown"
+#endif
+
+enum BENCH_FORMAT {
+    BENCH_FORMAT_CSV  = 0,
+    BENCH_FORMAT_JSON = 1,
+};
+
+/* setup() returns 1 when the case cannot run here and is skipped */
+enum BENCH_SETUP {
+    BENCH_SETUP_OK   = 0,
+    BENCH_SETUP_SKIP = 1,
+};
+
+typedef struct bench_t bench_t;
+
+struct bench_t {
+    const char *name;
+    const char *arg;
+    int       (*setup)(bench_t *bench);
+    int       (*run)(bench_t *bench);
+    void      (*teardown)(bench_t *bench);
+    int64_t     bytes;  /* bytes processed by one trial, 0 if not meaningful */
+    int64_t     ops;    /* operations in one trial */
+    char       *path;
+    int         fd;
+    char       *buf;
+    double      ratio;  /* compression ratio of the generated content */
+    void       *priv;
+};
+
+typedef struct bench_opts_t {
+    int         warmup;
+    int         trials;
+    const char *dir;
+    const char *filter;
+    int         format;
+} bench_opts_t;
+
+static bench_opts_t g_opts = {
+    .warmup = BENCH_DEFAULT_WARMUP,
+    .trials = BENCH_DEFAULT_TRIALS,
+    .dir    = BENCH_DEFAULT_DIR,
+    .filter = NULL,
+    .format = BENCH_FORMAT_CSV,
+};
+
+/* keeps the compiler from discarding the results of the sampling loops */
+static volatile uint64_t g_sink;
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t now_ticks(void)
+{
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static char *bench_path(const char *name)
+{
+    char *path = NULL;
+    if (asprintf(&path, "%s/dfgen-bench.%d.%s", g_opts.dir, getpid(), name) < 0)
+        return NULL;
+    return path;
+}
+
+/* content fill */
+
+static int fill_setup(bench_t *bench)
+{
+    if (!gencont_supported(bench->arg))
+        return BENCH_SETUP_SKIP;
+    if (gencont_select(bench->arg))
+        return -1;
+    bench->ratio = 1.0;
+
+    bench->buf = alloc_aligned(BENCH_BUFFER_SIZE, FUTIL_DIRECT_ALIGNMENT);
+    if (!bench->buf)
+        return -1;
+
+    bench->bytes = BENCH_FILL_BYTES;
+    bench->ops   = BENCH_FILL_BYTES / BENCH_BUFFER_SIZE;
+    return BENCH_SETUP_OK;
+}
+
+static int fill_run(bench_t *bench)
+{
+    uint64_t key = gencont_derive(BENCH_SEED, GENCONT_STREAM_NON_FIXED);
+
+    for (int64_t offset = 0; offset < bench->bytes; offset += BENCH_BUFFER_SIZE)
+        gencont_fill(key, bench->ratio, offset, bench->buf, BENCH_BUFFER_SIZE);
+
+    return 0;
+}
+
+static void fill_teardown(bench_t *bench)
+{
+    gencont_select(NULL);
+}
+
+/* compressible content, with the ratio given as "ratio-<n>" */
+static int compress_setup(bench_t *bench)
+{
+    bench->ratio = strtod(bench->arg + strlen("ratio-"), NULL);
+    if (!(bench->ratio >= 1.0))
+        return -1;
+
+    bench->buf = alloc_aligned(BENCH_BUFFER_SIZE, FUTIL_DIRECT_ALIGNMENT);
+    if (!bench->buf)
+        return -1;
+
+    bench->bytes = BENCH_FILL_BYTES;
+    bench->ops   = BENCH_FILL_BYTES / BENCH_BUFFER_SIZE;
+    return BENCH_SETUP_OK;
+}
+
+/* chunk-size sampling */
+
+static int sample_setup(bench_t *bench)
+{
+    bench->ops  = BENCH_SAMPLE_OPS;
+    bench->priv = calloc(1, sizeof(prng_t));
+    if (!bench->priv)
+        return -1;
+
+    prng_seed(bench->priv, gencont_derive(BENCH_SEED, GENCONT_STREAM_CHUNK_SIZE));
+    return BENCH_SETUP_OK;
+}
+
+static int sample_run(bench_t *bench)
+{
+    int64_t min = strcmp(bench->arg, "fixed") == 0 ? BENCH_CHUNK_SIZE : 4096;
+    int64_t max = BENCH_CHUNK_SIZE;
+    int64_t sum = 0;
+
+    for (int64_t i = 0; i < bench->ops; i++)
+        sum += random_chunk_size(bench->priv, min, max);
+    g_sink += sum;
+
+    return 0;
+}
+
+/* buffer allocation, both variants include the same fill */
+
+static int alloc_setup(bench_t *bench)
+{
+    bench->bytes = (int64_t)BENCH_CHUNK_SIZE * BENCH_CHUNK_OPS;
+    bench->ops   = BENCH_CHUNK_OPS;
+
+    if (strcmp(bench->arg, "pool") == 0) {
+        bench->priv = chunk_pool_create(BENCH_CHUNK_SIZE, 1);
+        if (!bench->priv)
+            return -1;
+    }
+    return BENCH_SETUP_OK;
+}
+
+static int alloc_run(bench_t *bench)
+{
+    uint64_t key = gencont_derive(BENCH_SEED, GENCONT_STREAM_NON_FIXED);
+
+    for (int64_t i = 0; i < bench->ops; i++) {
+        int64_t  offset = i * BENCH_CHUNK_SIZE;
+        chunk_t *chunk  = bench->priv ?
+            chunk_pool_get(bench->priv, BENCH_CHUNK_SIZE, key, 1.0, offset) :
+            chunk_create(BENCH_CHUNK_SIZE, key, 1.0, offset);
+        if (!chunk)
+            return -1;
+        g_sink += chunk->data[0];
+        chunk_destroy(chunk);
+    }
+
+    return 0;
+}
+
+static void alloc_teardown(bench_t *bench)
+{
+    if (bench->priv)
+        chunk_pool_destroy(bench->priv);
+    bench->priv = NULL;
+}
+
+/* buffered vs. direct writes, arg = "<target>/<mode>" */
+
+static int write_setup(bench_t *bench)
+{
+    int direct = strstr(bench->arg, "direct") != NULL;
+    int flags  = O_WRONLY | O_CREAT | (direct ? O_DIRECT : 0);
+
+    if (strncmp(bench->arg, "null", 4) == 0)
+        bench->path = strdup("/dev/null");
+    else
+        bench->path = bench_path("write");
+    if (!bench->path)
+        return -1;
+
+    bench->fd = open(bench->path, flags, 0644);
+    if (bench->fd < 0) {
+        /* e.g. a file system refusing O_DIRECT */
+        if (direct && errno == EINVAL)
+            return BENCH_SETUP_SKIP;
+        fprintf(stderr, "[ERROR]: failed to open %s, errno = %d\n", bench->path, errno);
+        return -1;
+    }
+
+    bench->buf = alloc_aligned(BENCH_BUFFER_SIZE, FUTIL_DIRECT_ALIGNMENT);
+    if (!bench->buf)
+        return -1;
+    gencont_fill(gencont_derive(BENCH_SEED, GENCONT_STREAM_NON_FIXED), 1.0, 0, bench->buf, BENCH_BUFFER_SIZE);
+
+    bench->bytes = BENCH_WRITE_BYTES;
+    bench->ops   = BENCH_WRITE_BYTES / BENCH_BUFFER_SIZE;
+    return BENCH_SETUP_OK;
+}
+
+static int write_run(bench_t *bench)
+{
+    for (int64_t offset = 0; offset < bench->bytes; offset += BENCH_BUFFER_SIZE) {
+        if (pwrite_full(bench->fd, bench->buf, BENCH_BUFFER_SIZE, offset)) {
+            fprintf(stderr, "[ERROR]: failed to write %s, errno = %d\n", bench->path, errno);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void write_teardown(bench_t *bench)
+{
+    if (bench->fd >= 0)
+        close(bench->fd);
+    if (bench->path && strncmp(bench->arg, "null", 4) != 0)
+        unlink(bench->path);
+}
+
+/* the whole generator, 64 MB into a scratch file */
+
+static param_t *generate_param(bench_t *bench)
+{
+    param_t *param = calloc(1, sizeof(param_t));
+    if (!param)
+        return NULL;
+    bench->priv = param;
+
+    bench->path = bench_path(bench->name);
+    if (!bench->path)
+        return NULL;
+
+    param->filename            = bench->path;
+    param->filesize            = BENCH_WRITE_BYTES;
+    param->fixed_ratio         = 20;
+    param->non_fixed_ratio     = 80;
+    param->fixed_part_size     = param->filesize * param->fixed_ratio / 100;
+    param->non_fixed_part_size = param->filesize - param->fixed_part_size;
+    param->chunk_size          = BENCH_CHUNK_SIZE;
+    param->chunk_size_min      = 4096;
+    param->chunk_size_max      = BENCH_CHUNK_SIZE;
+    param->quiet               = 1;
+    param->threads             = 1;
+    param->seed                = BENCH_SEED;
+
+    bench->bytes = param->filesize;
+    bench->ops   = 1;
+    return param;
+}
+
+/* file with holes, arg = number of threads */
+static int holes_setup(bench_t *bench)
+{
+    param_t *param = generate_param(bench);
+    if (!param)
+        return -1;
+
+    param->enable_holes = 1;
+    param->num_holes    = 64;
+    param->holes_size   = 16LL * 1024 * 1024;
+    param->threads      = atoi(bench->arg);
+    return BENCH_SETUP_OK;
+}
+
+/* output path without holes, arg = stdio (fwrite) or mmap */
+static int backend_setup(bench_t *bench)
+{
+    param_t *param = generate_param(bench);
+    if (!param)
+        return -1;
+
+    param->mmap = strcmp(bench->arg, "mmap") == 0;
+    return BENCH_SETUP_OK;
+}
+
+static int generate_run(bench_t *bench)
+{
+    return generate_file(bench->priv);
+}
+
+static void generate_teardown(bench_t *bench)
+{
+    if (bench->path)
+        unlink(bench->path);
+}
+
+static bench_t g_benches[] = {
+    { "fill",   "avx2",          fill_setup,   fill_run,   fill_teardown  },
+    { "fill",   "sse4",          fill_setup,   fill_run,   fill_teardown  },
+    { "fill",   "scalar",        fill_setup,   fill_run,   fill_teardown  },
+    { "fill",   "ratio-2.5",     compress_setup, fill_run, NULL           },
+    { "sample", "fixed",         sample_setup, sample_run, NULL           },
+    { "sample", "uniform",       sample_setup, sample_run, NULL           },
+    { "alloc",  "malloc",        alloc_setup,  alloc_run,  alloc_teardown },
+    { "alloc",  "pool",          alloc_setup,  alloc_run,  alloc_teardown },
+    { "write",  "null/buffered", write_setup,  write_run,  write_teardown },
+    { "write",  "null/direct",   write_setup,  write_run,  write_teardown },
+    { "write",  "tmpfs/buffered",write_setup,  write_run,  write_teardown },
+    { "write",  "tmpfs/direct",  write_setup,  write_run,  write_teardown },
+    { "holes",  "1",             holes_setup,  generate_run, generate_teardown },
+    { "holes",  "4",             holes_setup,  generate_run, generate_teardown },
+    { "output", "stdio",         backend_setup,generate_run, generate_teardown },
+    { "output", "mmap",          backend_setup,generate_run, generate_teardown },
+};
+
+static int cmp_u64(const void *lhs, const void *rhs)
+{
+    uint64_t l = *(const uint64_t *)lhs;
+    uint64_t r = *(const uint64_t *)rhs;
+    return (l > r) - (l < r);
+}
+
+static uint64_t median(const uint64_t *sorted, int n)
+{
+    if (n % 2)
+        return sorted[n/2];
+    return (sorted[n/2 - 1] + sorted[n/2]) / 2;
+}
+
+/* nearest-rank percentile */
+static uint64_t percentile(const uint64_t *sorted, int n, int pct)
+{
+    int rank = (n * pct + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void print_header(void)
+{
+    if (g_opts.format == BENCH_FORMAT_CSV)
+        fprintf(stdout, "case,trials,bytes,ops,median_ns,p99_ns,median_mb_per_s,p99_mb_per_s,"
+                        "ns_per_op,cycles_per_byte,cycles_per_op,compiler,cflags\n");
+}
+
+static void print_result(bench_t *bench, const char *name, uint64_t *ns, uint64_t *ticks, int n)
+{
+    qsort(ns, n, sizeof(uint64_t), cmp_u64);
+    qsort(ticks, n, sizeof(uint64_t), cmp_u64);
+
+    uint64_t med_ns    = median(ns, n);
+    uint64_t p99_ns    = percentile(ns, n, 99);
+    uint64_t med_ticks = median(ticks, n);
+
+    /* the p99 throughput is the one of the p99 (slow) trial */
+    double med_mbps    = med_ns ? bench->bytes / 1048576.0 / (med_ns / 1e9) : 0;
+    double p99_mbps    = p99_ns ? bench->bytes / 1048576.0 / (p99_ns / 1e9) : 0;
+    double ns_per_op   = bench->ops ? (double)med_ns / bench->ops : 0;
+    double cyc_per_b   = bench->bytes ? (double)med_ticks / bench->bytes : 0;
+    double cyc_per_op  = bench->ops ? (double)med_ticks / bench->ops : 0;
+
+    if (g_opts.format == BENCH_FORMAT_JSON) {
+        fprintf(stdout, "{\"case\":\"%s\",\"trials\":%d,\"bytes\":%ld,\"ops\":%ld,"
+                        "\"median_ns\":%lu,\"p99_ns\":%lu,\"median_mb_per_s\":%.2f,\"p99_mb_per_s\":%.2f,"
+                        "\"ns_per_op\":%.2f,\"cycles_per_byte\":%.4f,\"cycles_per_op\":%.2f,"
+                        "\"compiler\":\"%s\",\"cflags\":\"%s\"}\n",
+                name, n, bench->bytes, bench->ops, med_ns, p99_ns, med_mbps, p99_mbps,
+                ns_per_op, cyc_per_b, cyc_per_op, BENCH_COMPILER, BENCH_CFLAGS);
+    }
+    else {
+        fprintf(stdout, "%s,%d,%ld,%ld,%lu,%lu,%.2f,%.2f,%.2f,%.4f,%.2f,\"%s\",\"%s\"\n",
+                name, n, bench->bytes, bench->ops, med_ns, p99_ns, med_mbps, p99_mbps,
+                ns_per_op, cyc_per_b, cyc_per_op, BENCH_COMPILER, BENCH_CFLAGS);
+    }
+    fflush(stdout);
+}
+
+static int run_bench(bench_t *bench)
+{
+    char      name[64];
+    int       ret   = -1;
+    uint64_t *ns    = calloc(g_opts.trials, sizeof(uint64_t));
+    uint64_t *ticks = calloc(g_opts.trials, sizeof(uint64_t));
+
+    snprintf(name, sizeof(name), "%s/%s", bench->name, bench->arg);
+    if (g_opts.filter && !strstr(name, g_opts.filter)) {
+        ret = 0;
+        goto out;
+    }
+
+    if (!ns || !ticks)
+        goto out;
+
+    bench->fd = -1;
+    int status = bench->setup(bench);
+    if (status == BENCH_SETUP_SKIP) {
+        fprintf(stderr, "[WARN ]: %s is not supported here, skipped\n", name);
+        ret = 0;
+        goto teardown;
+    }
+    if (status) {
+        fprintf(stderr, "[ERROR]: failed to set up %s\n", name);
+        goto teardown;
+    }
+
+    for (int i = 0; i < g_opts.warmup; i++) {
+        if (bench->run(bench))
+            goto failed;
+    }
+
+    for (int i = 0; i < g_opts.trials; i++) {
+        uint64_t start_ns    = now_ns();
+        uint64_t start_ticks = now_ticks();
+        if (bench->run(bench))
+            goto failed;
+        ticks[i] = now_ticks() - start_ticks;
+        ns[i]    = now_ns() - start_ns;
+    }
+
+    print_result(bench, name, ns, ticks, g_opts.trials);
+    ret = 0;
+    goto teardown;
+
+failed:
+    fprintf(stderr, "[ERROR]: %s failed\n", name);
+teardown:
+    if (bench->teardown)
+        bench->teardown(bench);
+    free(bench->buf);
+    free(bench->path);
+    free(bench->priv);
+    bench->buf  = NULL;
+    bench->path = NULL;
+    bench->priv = NULL;
+out:
+    free(ns);
+    free(ticks);
+    return ret;
+}
+
+static void print_usage(const char *progname)
+{
+    const char *usage =
+    "Name:\n"
+    "   %s - micro-benchmarks of the dummy file generator stages\n"
+    "\n"
+    "Usage:\n"
+    "   %s [OPTION]...\n"
+    "\n"
+    "[OPTION]:\n"
+    "    -w, --warmup              number of untimed trials of every case, default = %d\n"
+    "    -n, --trials              number of timed trials of every case, default = %d\n"
+    "    -d, --dir                 directory of the scratch files, should be a tmpfs\n"
+    "                              default = %s\n"
+    "    -c, --case                only run the cases whose name contains <case>\n"
+    "    -o, --format              output format = { csv, json }, default = csv\n"
+    "    -h, --help                display this help text\n"
+    "\n"
+    "Cases:\n"
+    "    fill/<engine>             content engine, 64 MB per trial in 4 MB buffers\n"
+    "    sample/<fixed|uniform>    chunk size sampling, 1M sizes per trial\n"
+    "    alloc/<malloc|pool>       chunk_create() vs. chunk_pool_get() of 64 KB chunks\n"
+    "    write/<target>/<mode>     64 MB of buffered or O_DIRECT pwrite()s to /dev/null\n"
+    "                              or a file in <dir>\n"
+    "    holes/<threads>           generate_file() of 64 MB with 64 holes in <dir>\n"
+    "    output/<stdio|mmap>       generate_file() of 64 MB through fwrite() or --mmap in <dir>\n"
+    "\n"
+    "    Timings are per trial: median and p99 over the timed trials. Cycles are\n"
+    "    TSC ticks, 0 on CPUs without a TSC.\n"
+    "\n";
+
+    fprintf(stdout, usage, progname, progname,
+            BENCH_DEFAULT_WARMUP, BENCH_DEFAULT_TRIALS, BENCH_DEFAULT_DIR);
+}
+
+static int parse_cmds(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"warmup", required_argument, NULL, 'w'},
+        {"trials", required_argument, NULL, 'n'},
+        {"dir",    required_argument, NULL, 'd'},
+        {"case",   required_argument, NULL, 'c'},
+        {"format", required_argument, NULL, 'o'},
+        {"help",   no_argument,       NULL, 'h'},
+        {NULL,     0,                 NULL, 0},
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "w:n:d:c:o:h", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'w':
+            g_opts.warmup = atoi(optarg);
+            break;
+        case 'n':
+            g_opts.trials = atoi(optarg);
+            break;
+        case 'd':
+            g_opts.dir = optarg;
+            break;
+        case 'c':
+            g_opts.filter = optarg;
+            break;
+        case 'o':
+            if (strcmp(optarg, "csv") == 0)
+                g_opts.format = BENCH_FORMAT_CSV;
+            else if (strcmp(optarg, "json") == 0)
+                g_opts.format = BENCH_FORMAT_JSON;
+            else {
+                fprintf(stderr, "[ERROR]: unknown output format %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            exit(0);
+        default:
+            return -1;
+        }
+    }
+
+    if (g_opts.warmup < 0 || g_opts.trials <= 0) {
+        fprintf(stderr, "[ERROR]: invalid number of trials\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+
+    if (parse_cmds(argc, argv)) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    print_header();
+    for (int i = 0; i < sizeof(g_benches)/sizeof(g_benches[0]); i++) {
+        if (run_bench(&g_benches[i]))
+            ret = -1;
+    }
+
+    return ret;
+}
\ No newline at end of file
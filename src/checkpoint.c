@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "fprint.h"
+#include "futil.h"
+
+#define CHECKPOINT_MAGIC   "DFGCKPT"
+#define CHECKPOINT_VERSION 2
+
+typedef struct checkpoint_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t settings_size;
+    uint64_t state_size;
+} checkpoint_header_t;
+
+/* a setting of param_t, saved on its own in the checkpoint */
+typedef struct checkpoint_field_t {
+    const char *option;
+    size_t      offset;
+    size_t      size;
+} checkpoint_field_t;
+
+#define CHECKPOINT_FIELD(option, field) { option, offsetof(param_t, field), sizeof(((param_t *)0)->field) }
+
+/* the settings that decide the layout and content of the file */
+static const checkpoint_field_t checkpoint_fields[] = {
+    CHECKPOINT_FIELD("-s",               filesize),
+    CHECKPOINT_FIELD("-r",               fixed_ratio),
+    CHECKPOINT_FIELD("-r",               non_fixed_ratio),
+    CHECKPOINT_FIELD("-r",               fixed_part_size),
+    CHECKPOINT_FIELD("-r",               non_fixed_part_size),
+    CHECKPOINT_FIELD("-S",               chunk_size),
+    CHECKPOINT_FIELD("-m",               chunk_size_min),
+    CHECKPOINT_FIELD("-M",               chunk_size_max),
+    CHECKPOINT_FIELD("-H",               enable_holes),
+    CHECKPOINT_FIELD("-N",               num_holes),
+    CHECKPOINT_FIELD("-O",               holes_size),
+    CHECKPOINT_FIELD("--seed",           seed),
+    CHECKPOINT_FIELD("--compress-ratio", compress_ratio),
+    CHECKPOINT_FIELD("--patterns",       fixed_patterns),
+    CHECKPOINT_FIELD("--pattern-dist",   pattern_dist),
+    CHECKPOINT_FIELD("--pattern-dist",   pattern_skew),
+    CHECKPOINT_FIELD("--pattern-dist",   hot_ratio),
+    CHECKPOINT_FIELD("--pattern-dist",   hot_traffic),
+};
+
+#define CHECKPOINT_NUM_FIELDS (sizeof(checkpoint_fields)/sizeof(checkpoint_fields[0]))
+
+/* the saved settings: every field above packed in order, then the checkpoint interval */
+static size_t settings_size(void)
+{
+    size_t size = sizeof(int64_t);
+
+    for (int i = 0 ; i < CHECKPOINT_NUM_FIELDS; i++)
+        size += checkpoint_fields[i].size;
+    return size;
+}
+
+static char *pack_settings(char *pos, const param_t *param)
+{
+    for (int i = 0 ; i < CHECKPOINT_NUM_FIELDS; i++) {
+        memcpy(pos, (const char *)param + checkpoint_fields[i].offset, checkpoint_fields[i].size);
+        pos += checkpoint_fields[i].size;
+    }
+    memcpy(pos, &param->checkpoint_interval, sizeof(int64_t));
+    return pos + sizeof(int64_t);
+}
+
+static const char *unpack_settings(const char *pos, param_t *param)
+{
+    for (int i = 0 ; i < CHECKPOINT_NUM_FIELDS; i++) {
+        memcpy((char *)param + checkpoint_fields[i].offset, pos, checkpoint_fields[i].size);
+        pos += checkpoint_fields[i].size;
+    }
+    memcpy(&param->checkpoint_interval, pos, sizeof(int64_t));
+    return pos + sizeof(int64_t);
+}
+
+char *checkpoint_path(const char *filename)
+{
+    if (!filename) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t length = strlen(filename) + sizeof(CHECKPOINT_SUFFIX);
+    char  *path   = malloc(length);
+    if (path)
+        snprintf(path, length, "%s%s", filename, CHECKPOINT_SUFFIX);
+
+    return path;
+}
+
+/* the rename is only durable once the directory holding it is synced */
+static void sync_parent(const char *path)
+{
+    char *copy = strdup(path);
+    if (!copy)
+        return;
+
+    int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    free(copy);
+}
+
+int checkpoint_write(const char *filename, const param_t *param, int64_t durable,
+                     const void *state, size_t state_size)
+{
+    if (!filename || !param || (!state && state_size)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    checkpoint_header_t header = {
+        .magic         = CHECKPOINT_MAGIC,
+        .version       = CHECKPOINT_VERSION,
+        .settings_size = settings_size(),
+        .state_size    = state_size,
+    };
+    size_t size = sizeof(header) + header.settings_size + sizeof(durable) + state_size;
+    char  *buf  = calloc(1, size + sizeof(uint64_t));
+    if (!buf)
+        return -1;
+
+    char *pos = buf;
+    memcpy(pos, &header, sizeof(header));
+    pos += sizeof(header);
+    pos = pack_settings(pos, param);
+    memcpy(pos, &durable, sizeof(durable));
+    pos += sizeof(durable);
+    if (state_size)
+        memcpy(pos, state, state_size);
+    uint64_t checksum = fingerprint(buf, size);
+    memcpy(buf + size, &checksum, sizeof(checksum));
+
+    char *path = checkpoint_path(filename);
+    char *temp = path ? malloc(strlen(path) + 5) : NULL;
+    int   error = -1;
+    int   fd    = -1;
+
+    if (!temp)
+        goto cleanup;
+    sprintf(temp, "%s.tmp", path);
+
+    fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0 || pwrite_full(fd, buf, size + sizeof(checksum), 0) || fdatasync(fd))
+        goto cleanup;
+    if (close(fd)) {
+        fd = -1;
+        goto cleanup;
+    }
+    fd = -1;
+
+    if (rename(temp, path))
+        goto cleanup;
+    sync_parent(path);
+    error = 0;
+
+cleanup:
+    if (error)
+        fprintf(stderr, "[ERROR]: failed to write the checkpoint of %s: %s\n", filename, strerror(errno));
+    if (fd >= 0)
+        close(fd);
+    free(temp);
+    free(path);
+    free(buf);
+
+    return error;
+}
+
+int checkpoint_read(const char *filename, param_t *param, int64_t *durable, void *state, size_t state_size)
+{
+    if (!filename || !param) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *path = checkpoint_path(filename);
+    if (!path)
+        return -1;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "[ERROR]: failed to open the checkpoint %s: %s\n", path, strerror(errno));
+        free(path);
+        return -1;
+    }
+
+    checkpoint_header_t header;
+    char               *buf   = NULL;
+    int                 error = -1;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) ||
+        header.version != CHECKPOINT_VERSION || header.settings_size != settings_size() ||
+        (state && header.state_size != state_size)) {
+        fprintf(stderr, "[ERROR]: %s is not a checkpoint of this version of dfgen\n", path);
+        errno = EINVAL;
+        goto cleanup;
+    }
+
+    size_t size = sizeof(header) + header.settings_size + sizeof(int64_t) + header.state_size;
+    buf = malloc(size + sizeof(uint64_t));
+    if (!buf)
+        goto cleanup;
+    memcpy(buf, &header, sizeof(header));
+
+    uint64_t checksum;
+    if (fread(buf + sizeof(header), size - sizeof(header) + sizeof(checksum), 1, fp) != 1 ||
+        (memcpy(&checksum, buf + size, sizeof(checksum)), checksum != fingerprint(buf, size))) {
+        fprintf(stderr, "[ERROR]: the checkpoint %s is damaged\n", path);
+        errno = EINVAL;
+        goto cleanup;
+    }
+
+    memset(param, 0, sizeof(param_t));
+    const char *pos = unpack_settings(buf + sizeof(header), param);
+    if (durable)
+        memcpy(durable, pos, sizeof(int64_t));
+    pos += sizeof(int64_t);
+    if (state)
+        memcpy(state, pos, state_size);
+    error = 0;
+
+cleanup:
+    fclose(fp);
+    free(buf);
+    free(path);
+
+    return error;
+}
+
+int checkpoint_remove(const char *filename)
+{
+    char *path = checkpoint_path(filename);
+    if (!path)
+        return -1;
+
+    int error = unlink(path) && errno != ENOENT ? -1 : 0;
+    free(path);
+
+    return error;
+}
+
+void checkpoint_restore(param_t *param, const param_t *saved)
+{
+    for (int i = 0 ; i < CHECKPOINT_NUM_FIELDS; i++) {
+        memcpy((char *)param + checkpoint_fields[i].offset, (const char *)saved + checkpoint_fields[i].offset,
+            checkpoint_fields[i].size);
+    }
+    if (param->checkpoint_interval <= 0)
+        param->checkpoint_interval = saved->checkpoint_interval;
+}
+
+const char *checkpoint_differs(const param_t *param, const param_t *saved)
+{
+    for (int i = 0 ; i < CHECKPOINT_NUM_FIELDS; i++) {
+        if (memcmp((const char *)param + checkpoint_fields[i].offset, (const char *)saved + checkpoint_fields[i].offset,
+                checkpoint_fields[i].size))
+            return checkpoint_fields[i].option;
+    }
+    return NULL;
+}
\ No newline at end of file
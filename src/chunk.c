@@ -4,11 +4,21 @@
 #include "chunk.h"
 #include "gencont.h"
 
-#define min(a,b) (((a)>(b))?(b):(a))
+#define CHUNK_POOL_ALIGNMENT 4096
 
-chunk_t *chunk_create(int64_t size)
+struct chunk_pool_t {
+    int64_t   max_size;
+    int       num_chunks;
+    int       num_free;
+    char     *arena;
+    chunk_t  *chunks;
+    chunk_t **free_list;
+    uint64_t  allocs_avoided;
+};
+
+chunk_t *chunk_create(int64_t size, uint64_t key, double ratio, int64_t offset)
 {
-    if (size <= 0) {
+    if (size <= 0 || offset < 0) {
         errno = EINVAL;
         return NULL;
     }
@@ -24,20 +34,7 @@ chunk_t *chunk_create(int64_t size)
         return NULL;
     }
 
-    int64_t sizeof_int         = sizeof(int);
-    int64_t processed_bytes    = 0;
-    int64_t available_bytes    = 0;
-    int64_t bytes_to_processed = size;
-    int     content            = 0;
-    char   *curptr             = chunk->data;
-
-    while (processed_bytes < bytes_to_processed) {
-        available_bytes = min(sizeof_int, bytes_to_processed - processed_bytes);
-        content = rand();
-        memcpy(curptr, &content, available_bytes);
-        curptr += available_bytes;
-        processed_bytes += available_bytes;
-    }
+    gencont_fill(key, ratio, offset, chunk->data, size);
 
     return chunk;
 }
@@ -46,6 +43,12 @@ void chunk_destroy(chunk_t *chunk)
 {
     if (!chunk)
         return;
+
+    if (chunk->pool) {
+        chunk_pool_t *pool = chunk->pool;
+        pool->free_list[pool->num_free++] = chunk;
+        return;
+    }
     
     if (chunk->data)
         free(chunk->data);
@@ -54,3 +57,78 @@ void chunk_destroy(chunk_t *chunk)
     free(chunk);
 }
 
+chunk_pool_t *chunk_pool_create(int64_t max_size, int num_chunks)
+{
+    if (max_size <= 0 || num_chunks <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    chunk_pool_t *pool = calloc(1, sizeof(chunk_pool_t));
+    if (!pool)
+        return NULL;
+
+    pool->max_size   = max_size;
+    pool->num_chunks = num_chunks;
+    pool->chunks     = calloc(num_chunks, sizeof(chunk_t));
+    pool->free_list  = calloc(num_chunks, sizeof(chunk_t *));
+    if (!pool->chunks || !pool->free_list)
+        goto error;
+
+    if (posix_memalign((void **)&pool->arena, CHUNK_POOL_ALIGNMENT, max_size * num_chunks)) {
+        pool->arena = NULL;
+        goto error;
+    }
+    /* fault the arena in once, up front */
+    memset(pool->arena, 0, max_size * num_chunks);
+
+    for (int i = 0 ; i < num_chunks; i++) {
+        pool->chunks[i].data = pool->arena + i * max_size;
+        pool->chunks[i].pool = pool;
+        pool->free_list[i]   = &pool->chunks[num_chunks - 1 - i];
+    }
+    pool->num_free = num_chunks;
+
+    return pool;
+
+error:
+    chunk_pool_destroy(pool);
+    errno = ENOMEM;
+    return NULL;
+}
+
+chunk_t *chunk_pool_get(chunk_pool_t *pool, int64_t size, uint64_t key, double ratio, int64_t offset)
+{
+    if (!pool || size <= 0 || size > pool->max_size || offset < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (pool->num_free == 0) {
+        errno = ENOBUFS;
+        return NULL;
+    }
+
+    chunk_t *chunk = pool->free_list[--pool->num_free];
+    chunk->size = size;
+    gencont_fill(key, ratio, offset, chunk->data, size);
+    pool->allocs_avoided++;
+
+    return chunk;
+}
+
+uint64_t chunk_pool_allocs_avoided(chunk_pool_t *pool)
+{
+    return pool ? pool->allocs_avoided : 0;
+}
+
+void chunk_pool_destroy(chunk_pool_t *pool)
+{
+    if (!pool)
+        return;
+
+    free(pool->arena);
+    free(pool->chunks);
+    free(pool->free_list);
+    free(pool);
+}
\ No newline at end of file
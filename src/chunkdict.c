@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "chunkdict.h"
+#include "futil.h"
+#include "gencont.h"
+
+#define CHUNK_DICT_MAGIC     "dfgen-dict v1"
+/* the pool is generated through a buffer of this size */
+#define CHUNK_DICT_FILL_SIZE (4LL * 1024 * 1024)
+
+#define min(a,b) (((a)>(b))?(b):(a))
+
+/*
+ * Write the whole pool under a temporary name and link it into place, so
+ * that generators starting at the same time either see no pool or a
+ * complete one. The first link wins, the others use its pool.
+ */
+static int chunk_dict_create(param_t *param)
+{
+    const char *path       = param->dict_path;
+    int64_t     chunk_size = param->chunk_size;
+    int64_t     num_chunks = param->dict_chunks;
+    int64_t     data_size  = chunk_size * num_chunks;
+    uint64_t    seed       = gencont_derive(param->seed, GENCONT_STREAM_DICT);
+    char        tmp[PATH_MAX];
+    char       *buf        = NULL;
+    int         error      = -1;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    int fd = mkstemp(tmp);
+    if (fd < 0)
+        return -1;
+
+    buf = alloc_aligned(CHUNK_DICT_FILL_SIZE, FUTIL_DIRECT_ALIGNMENT);
+    if (!buf)
+        goto cleanup;
+
+    snprintf(buf, CHUNK_DICT_HEADER_SIZE, "%s chunk-size %ld chunks %ld seed %llu\n",
+        CHUNK_DICT_MAGIC, chunk_size, num_chunks, (unsigned long long)seed);
+    if (pwrite_full(fd, buf, CHUNK_DICT_HEADER_SIZE, 0))
+        goto cleanup;
+
+    /* the chunks are consecutive slices of one stream */
+    for (int64_t offset = 0 ; offset < data_size; offset += CHUNK_DICT_FILL_SIZE) {
+        int64_t length = min(data_size - offset, CHUNK_DICT_FILL_SIZE);
+        gencont_fill(seed, param->compress_ratio, offset, buf, length);
+        if (pwrite_full(fd, buf, length, CHUNK_DICT_HEADER_SIZE + offset))
+            goto cleanup;
+    }
+
+    if (fchmod(fd, 0644) || fsync(fd))
+        goto cleanup;
+
+    if (link(tmp, path) && errno != EEXIST)
+        goto cleanup;
+
+    if (!param->quiet)
+        fprintf(stdout, "[INFO ]: created chunk dictionary %s: %ld chunks of %ld bytes\n", path, num_chunks, chunk_size);
+    error = 0;
+
+cleanup:
+    unlink(tmp);
+    close(fd);
+    free(buf);
+
+    return error;
+}
+
+static int chunk_dict_load(chunk_dict_t *dict, const char *path)
+{
+    char               header[CHUNK_DICT_HEADER_SIZE] = "";
+    long               chunk_size = 0;
+    long               num_chunks = 0;
+    unsigned long long seed       = 0;
+    struct stat        st;
+
+    if (pread(dict->fd, header, sizeof(header) - 1, 0) < 0 || fstat(dict->fd, &st))
+        return -1;
+
+    if (sscanf(header, CHUNK_DICT_MAGIC " chunk-size %ld chunks %ld seed %llu",
+            &chunk_size, &num_chunks, &seed) != 3 ||
+        chunk_size <= 0 || chunk_size > PARAM_MAX_CHUNK_SIZE || num_chunks <= 0 ||
+        num_chunks > (st.st_size - CHUNK_DICT_HEADER_SIZE) / chunk_size) {
+        fprintf(stderr, "[ERROR]: %s is not a complete chunk dictionary\n", path);
+        errno = EINVAL;
+        return -1;
+    }
+
+    dict->chunk_size = chunk_size;
+    dict->num_chunks = num_chunks;
+    dict->seed       = seed;
+    dict->map_size   = CHUNK_DICT_HEADER_SIZE + chunk_size * num_chunks;
+
+    return 0;
+}
+
+chunk_dict_t *chunk_dict_open(param_t *param, int create)
+{
+    if (!param || !param->dict_path) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    chunk_dict_t *dict = calloc(1, sizeof(chunk_dict_t));
+    if (!dict)
+        return NULL;
+    dict->map = MAP_FAILED;
+
+    dict->fd = open(param->dict_path, O_RDONLY);
+    if (dict->fd < 0 && errno == ENOENT && create) {
+        if (chunk_dict_create(param))
+            goto error;
+        dict->fd = open(param->dict_path, O_RDONLY);
+    }
+    if (dict->fd < 0)
+        goto error;
+
+    if (chunk_dict_load(dict, param->dict_path))
+        goto error;
+
+    /* shared with every other generator using the pool, nobody gets a private copy */
+    dict->map = mmap(NULL, dict->map_size, PROT_READ, MAP_SHARED, dict->fd, 0);
+    if (dict->map == MAP_FAILED)
+        goto error;
+    madvise(dict->map, dict->map_size, MADV_WILLNEED);
+
+    return dict;
+
+error:
+    fprintf(stderr, "[ERROR]: failed to open chunk dictionary %s: %s\n", param->dict_path, strerror(errno));
+    chunk_dict_close(dict);
+    return NULL;
+}
+
+void chunk_dict_close(chunk_dict_t *dict)
+{
+    if (!dict)
+        return;
+
+    if (dict->map != MAP_FAILED)
+        munmap(dict->map, dict->map_size);
+    if (dict->fd >= 0)
+        close(dict->fd);
+    free(dict);
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "dedupidx.h"
+#include "futil.h"
+#include "fprint.h"
+
+/* "%016ld %016ld %c    %016lx\n" */
+#define DEDUP_RECORD_SIZE  56
+#define DEDUP_BATCH        128
+
+struct dedup_index_t {
+    int     fd;
+    int64_t header_size;
+};
+
+dedup_index_t *dedup_index_create(const char *path, param_t *param)
+{
+    if (!path || !param) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    dedup_index_t *idx = calloc(1, sizeof(dedup_index_t));
+    if (!idx)
+        return NULL;
+
+    idx->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (idx->fd < 0) {
+        fprintf(stderr, "[ERROR]: failed to create dedup index %s: %s\n", path, strerror(errno));
+        free(idx);
+        return NULL;
+    }
+
+    char header[1024];
+    int  len = snprintf(header, sizeof(header),
+        "# dfgen dedup index v1\n"
+        "# file %s size %ld fixed-ratio %d chunk-size %ld chunk-size-min %ld chunk-size-max %ld seed %llu\n"
+        "# holes %ld holes-size %ld compress-ratio %.2f fingerprint %s\n"
+        "# offset          length           kind fingerprint\n",
+        param->filename, param->filesize, param->fixed_ratio, param->chunk_size,
+        param->chunk_size_min, param->chunk_size_max, (unsigned long long)param->seed,
+        param->enable_holes ? param->num_holes : 0, param->enable_holes ? param->holes_size : 0,
+        param->compress_ratio > 1.0 ? param->compress_ratio : 1.0, fingerprint_name());
+    if (len < 0 || len >= sizeof(header) || pwrite_full(idx->fd, header, len, 0)) {
+        fprintf(stderr, "[ERROR]: failed to write dedup index header\n");
+        dedup_index_destroy(idx);
+        return NULL;
+    }
+    idx->header_size = len;
+
+    return idx;
+}
+
+int dedup_index_write(dedup_index_t *idx, int64_t first, const dedup_record_t *records, int num_records)
+{
+    char buf[DEDUP_BATCH * DEDUP_RECORD_SIZE + 1];
+
+    while (num_records > 0) {
+        int n = num_records < DEDUP_BATCH ? num_records : DEDUP_BATCH;
+
+        for (int i = 0 ; i < n; i++) {
+            snprintf(buf + i * DEDUP_RECORD_SIZE, DEDUP_RECORD_SIZE + 1, "%016ld %016ld %c    %016lx\n",
+                records[i].offset, records[i].length, records[i].kind, records[i].fingerprint);
+        }
+        if (pwrite_full(idx->fd, buf, n * DEDUP_RECORD_SIZE, idx->header_size + first * DEDUP_RECORD_SIZE))
+            return -1;
+
+        first       += n;
+        records     += n;
+        num_records -= n;
+    }
+
+    return 0;
+}
+
+int dedup_index_finish(dedup_index_t *idx, int64_t num_records, const dedup_summary_t *summary)
+{
+    char buf[512];
+    int  len = snprintf(buf, sizeof(buf),
+        "# summary: chunks %ld holes %ld data-bytes %ld hole-bytes %ld unique-bytes %ld dedup-ratio %.4f\n",
+        summary->num_chunks, summary->num_holes, summary->data_bytes, summary->hole_bytes,
+        summary->unique_bytes,
+        summary->unique_bytes > 0 ? (double)summary->data_bytes / summary->unique_bytes : 1.0);
+
+    return pwrite_full(idx->fd, buf, len, idx->header_size + num_records * DEDUP_RECORD_SIZE);
+}
+
+void dedup_index_destroy(dedup_index_t *idx)
+{
+    if (!idx)
+        return;
+
+    if (idx->fd >= 0)
+        close(idx->fd);
+    free(idx);
+}
\ No newline at end of file
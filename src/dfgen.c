@@ -0,0 +1,511 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "dfgen.h"
+#include "genfile.h"
+#include "gencont.h"
+#include "gentree.h"
+#include "mutate.h"
+#include "checkpoint.h"
+#include "sink.h"
+
+#define DEFAULT_FIXED_RATIO 20
+#define DEFAULT_CHUNK_SIZE  65536 /* 64 KB */
+#define DEFAULT_DICT_CHUNKS 1024
+#define DEFAULT_OVERLAP     50
+#define DEFAULT_ZIPF_SKEW   1.0
+#define DEFAULT_HOT_RATIO   20
+#define DEFAULT_HOT_TRAFFIC 80
+#define DEFAULT_TREE_FANOUT 16
+#define DEFAULT_DIR_FILES   256
+#define DEFAULT_FILE_MIN    4096    /* 4 KB */
+#define DEFAULT_FILE_MAX    1048576 /* 1 MB */
+#define DEFAULT_CHANGE      5.0
+#define DEFAULT_EDITS       16
+#define DEFAULT_RATE_PERIOD 10.0
+
+struct dfgen_t {
+    param_t       param;
+    sink_output_t output;
+};
+
+static inline int dfgen_in_memory(const param_t *param)
+{
+    return param->output && param->output->type >= 0;
+}
+
+void dfgen_param_init(param_t *param)
+{
+    struct timespec now;
+
+    memset(param, 0, sizeof(param_t));
+    param->fixed_ratio     = DEFAULT_FIXED_RATIO;
+    param->non_fixed_ratio = 100 - DEFAULT_FIXED_RATIO;
+    param->chunk_size      = DEFAULT_CHUNK_SIZE;
+    param->chunk_size_min  = DEFAULT_CHUNK_SIZE;
+    param->chunk_size_max  = DEFAULT_CHUNK_SIZE;
+    param->threads         = 1;
+    param->mem_limit       = PARAM_DEFAULT_MEM_LIMIT;
+    param->dict_chunks     = DEFAULT_DICT_CHUNKS;
+    param->overlap         = -1;
+    param->compress_ratio  = 1.0;
+    param->fixed_patterns  = 1;
+    param->pattern_dist    = PATTERN_DIST_UNIFORM;
+    param->pattern_skew    = DEFAULT_ZIPF_SKEW;
+    param->hot_ratio       = DEFAULT_HOT_RATIO;
+    param->hot_traffic     = DEFAULT_HOT_TRAFFIC;
+    param->tree_fanout     = DEFAULT_TREE_FANOUT;
+    param->tree_dir_files  = DEFAULT_DIR_FILES;
+    param->file_size_min   = DEFAULT_FILE_MIN;
+    param->file_size_max   = DEFAULT_FILE_MAX;
+    param->change_ratio    = DEFAULT_CHANGE;
+    param->num_edits       = DEFAULT_EDITS;
+    param->edit_mix[EDIT_KIND_OVERWRITE] = 50;
+    param->edit_mix[EDIT_KIND_INSERT]    = 20;
+    param->edit_mix[EDIT_KIND_DELETE]    = 20;
+    param->edit_mix[EDIT_KIND_APPEND]    = 5;
+    param->edit_mix[EDIT_KIND_TRUNCATE]  = 5;
+    param->rate_period     = DEFAULT_RATE_PERIOD;
+
+    /* used for generating random content */
+    clock_gettime(CLOCK_REALTIME, &now);
+    param->seed = gencont_derive(now.tv_sec * 1000000000ULL + now.tv_nsec, getpid());
+}
+
+/* the settings of --tree, and the single file settings it does not take */
+static int check_tree(const param_t *param)
+{
+    int error = 0;
+
+    if (param->fixed_ratio < 0 || param->fixed_ratio > 100) {
+        fprintf(stderr, "[ERROR]: fixed ratio must be a integer in range [ 0 - 100 ]\n");
+        error++;
+    }
+
+    if (param->chunk_size > PARAM_MAX_CHUNK_SIZE) {
+        fprintf(stderr, "[ERROR]: chunk size should not exceed %lld bytes\n", PARAM_MAX_CHUNK_SIZE);
+        error++;
+    }
+
+    if (param->tree_files <= 0) {
+        fprintf(stderr, "[ERROR]: must set the number of files of the tree with --tree-files <n>\n");
+        error++;
+    }
+
+    if (param->tree_fanout < 2 || param->tree_dir_files < 1) {
+        fprintf(stderr, "[ERROR]: a tree needs a fanout of 2 or more, and 1 or more files per directory\n");
+        error++;
+    }
+
+    if (param->file_size_min <= 0 || param->file_size_max < param->file_size_min) {
+        fprintf(stderr, "[ERROR]: the max file size should always greater or equal to the min file size\n");
+        error++;
+    }
+
+    if (param->file_size_max * param->threads > (param->mem_limit > 0 ? param->mem_limit : PARAM_DEFAULT_MEM_LIMIT)) {
+        fprintf(stderr, "[ERROR]: %d buffers of the max file size do not fit under the memory limit\n", param->threads);
+        error++;
+    }
+
+    if (param->filename || param->enable_holes || param->dict_path || param->fixed_patterns > 1 ||
+        param->index_path || param->verify || param->direct || param->async || param->mmap ||
+        param->copy_range || dfgen_in_memory(param)) {
+        fprintf(stderr, "[ERROR]: --tree can not be combined with -f, -H, -D, -A, --mmap, --copy-range, --dict,\n"
+                        "         --patterns, --index, --verify or an in-memory output\n");
+        error++;
+    }
+
+    if (param->rate || param->duration > 0 || param->loops > 1 ||
+        param->prealloc || param->sync_mode != SYNC_MODE_NONE || param->drop_cache) {
+        fprintf(stderr, "[ERROR]: --rate, --duration, --loop, --prealloc, --sync and --drop-cache apply to\n"
+                        "         a single file, not to --tree\n");
+        error++;
+    }
+
+    return error;
+}
+
+/* the settings of --mutate, which takes none of the settings of a new file */
+static int check_mutate(const param_t *param)
+{
+    int error = 0;
+    int total = 0;
+
+    if (!(param->change_ratio > 0.0 && param->change_ratio <= 100.0)) {
+        fprintf(stderr, "[ERROR]: the change should be a percentage in range ( 0 - 100 ]\n");
+        error++;
+    }
+
+    if (param->num_edits <= 0) {
+        fprintf(stderr, "[ERROR]: number of edits should be larger than 0\n");
+        error++;
+    }
+
+    for (int k = 0 ; k < EDIT_KIND_LAST; k++)
+        total += param->edit_mix[k] >= 0 ? param->edit_mix[k] : -1000;
+    if (total <= 0) {
+        fprintf(stderr, "[ERROR]: the edit mix needs a positive weight, and no negative one\n");
+        error++;
+    }
+
+    if (param->filename || param->tree_path || param->verify || param->index_path || dfgen_in_memory(param)) {
+        fprintf(stderr, "[ERROR]: --mutate can not be combined with -f, --tree, --verify, --index or an in-memory output\n");
+        error++;
+    }
+
+    if (param->rate || param->duration > 0 || param->loops > 1) {
+        fprintf(stderr, "[ERROR]: --rate, --duration and --loop apply to a single file, not to --mutate\n");
+        error++;
+    }
+
+    return error;
+}
+
+int dfgen_param_check(const param_t *param)
+{
+    int error = 0;
+
+    if (!(param->compress_ratio >= 1.0)) {
+        fprintf(stderr, "[ERROR]: compression ratio should be at least 1.0\n");
+        error++;
+    }
+
+    if (param->mutate_path)
+        return error + check_mutate(param);
+
+    if (param->tree_path)
+        return error + check_tree(param);
+
+    if (!param->filename && !dfgen_in_memory(param)) {
+        fprintf(stderr, "[ERROR]: must set filename with -f <filename>\n");
+        error++;
+    }
+
+    if (param->filesize <= 0) {
+        fprintf(stderr, "[ERROR]: must set filesize >= 0 bytes with -s <size>\n");
+        error++;
+    }
+
+    if (param->fixed_ratio < 0 || param->fixed_ratio > 100) {
+        fprintf(stderr, "[ERROR]: fixed ratio must be a integer in range [ 0 - 100 ]\n");
+        error++;
+    }
+
+    if (param->non_fixed_ratio < 0 || param->non_fixed_ratio > 100) {
+        fprintf(stderr, "[ERROR]: invalid non fixed ratio\n");
+        error++;
+    }
+
+    if (param->filesize < param->chunk_size) {
+        fprintf(stderr, "[ERROR]: chunk size should always smaller than the file size\n");
+        error++;
+    }
+
+    if (param->chunk_size > PARAM_MAX_CHUNK_SIZE || param->chunk_size_max > PARAM_MAX_CHUNK_SIZE) {
+        fprintf(stderr, "[ERROR]: chunk size should not exceed %lld bytes\n", PARAM_MAX_CHUNK_SIZE);
+        error++;
+    }
+
+    if (param->chunk_size_max < param->chunk_size_min) {
+        fprintf(stderr, "[ERROR]: max chunk size should always greater or equal to min chunk size\n");
+        error++;
+    }
+
+    if (param->enable_holes && param->holes_size <= 0) {
+        fprintf(stderr, "[ERROR]: total size of the hole should always greater than 0 bytes\n");
+        error++;
+    }
+
+    if (param->enable_holes && param->num_holes <= 0) {
+        fprintf(stderr, "[ERROR]: number of holes should greater than 0 if enable generating holes mode\n");
+        error++;
+    }
+
+    if (param->enable_holes && param->num_holes > param->holes_size) {
+        fprintf(stderr, "[ERROR]: number of the holes should always smaller than the total size of the holes\n");
+        error++;
+    }
+
+    if (param->overlap >= 0 && !param->dict_path) {
+        fprintf(stderr, "[ERROR]: --overlap needs a chunk dictionary, set with --dict <path>\n");
+        error++;
+    }
+
+    if (param_is_stream(param) && param->verify) {
+        fprintf(stderr, "[ERROR]: can not verify a stream, save it to a file first\n");
+        error++;
+    }
+
+    if (param->mmap && (param->direct || param->async || param_is_stream(param))) {
+        fprintf(stderr, "[ERROR]: --mmap can not be combined with -D, -A or streaming\n");
+        error++;
+    }
+
+    if (param->copy_range && (param->direct || param->async || param->mmap || param_is_stream(param))) {
+        fprintf(stderr, "[ERROR]: --copy-range only applies to plain writes, not to -D, -A, --mmap or streaming\n");
+        error++;
+    }
+
+    if (dfgen_in_memory(param) &&
+        (param->direct || param->async || param->mmap || param->copy_range || param_is_stream(param))) {
+        fprintf(stderr, "[ERROR]: in-memory outputs can not be combined with -D, -A, --mmap, --copy-range or streaming\n");
+        error++;
+    }
+
+    if (param_is_stream(param) && (param->direct || param->async)) {
+        fprintf(stderr, "[ERROR]: direct and async I/O are not available when streaming to stdout\n");
+        error++;
+    }
+
+    if ((param->prealloc || param->sync_mode != SYNC_MODE_NONE || param->drop_cache) &&
+        (param->verify || param_is_stream(param) || dfgen_in_memory(param))) {
+        fprintf(stderr, "[ERROR]: --prealloc, --sync and --drop-cache only apply to writing a file\n");
+        error++;
+    }
+
+    if (param->sync_mode == SYNC_MODE_EVERY && param->sync_every <= 0) {
+        fprintf(stderr, "[ERROR]: --sync every:<size> needs a size larger than 0 bytes\n");
+        error++;
+    }
+
+    if ((param->checkpoint_interval > 0 || param->resume) &&
+        (param->async || param->verify || param->index_path || param->dict_path || param_is_stream(param) ||
+         dfgen_in_memory(param) || param->duration > 0 || param->loops > 1)) {
+        fprintf(stderr, "[ERROR]: --checkpoint and --resume can not be combined with -A, --verify, --index, --dict,\n"
+                        "         --duration, --loop, streaming or an in-memory output\n");
+        error++;
+    }
+
+    if (param->checkpoint_interval < 0) {
+        fprintf(stderr, "[ERROR]: the checkpoint interval can not be negative\n");
+        error++;
+    }
+
+    if (param->rate < 0 || param->duration < 0 || param->loops < 0) {
+        fprintf(stderr, "[ERROR]: rate, duration and number of loops can not be negative\n");
+        error++;
+    }
+
+    if (param->rate_profile != RATE_PROFILE_CONSTANT && (param->rate <= 0 || param->rate_period <= 0)) {
+        fprintf(stderr, "[ERROR]: a rate profile needs --rate and a period larger than 0 seconds\n");
+        error++;
+    }
+
+    if (param->rate_profile == RATE_PROFILE_SQUARE && (param->rate_low < 0 || param->rate_low >= 100)) {
+        fprintf(stderr, "[ERROR]: the low rate of a square wave should be a percentage in range [ 0 - 100 )\n");
+        error++;
+    }
+
+    if ((param->duration > 0 || param->loops > 1) && (param->verify || param->index_path || param_is_stream(param))) {
+        fprintf(stderr, "[ERROR]: --duration and --loop rewrite the file, they can not be combined with --verify,\n"
+                        "         --index or streaming\n");
+        error++;
+    }
+
+    return error;
+}
+
+int dfgen_param_resume(param_t *param)
+{
+    param_t saved;
+
+    if (!param) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!param->filename || param_is_stream(param)) {
+        fprintf(stderr, "[ERROR]: --resume needs the file to carry on with, -f <file>\n");
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (checkpoint_read(param->filename, &saved, NULL, NULL, 0))
+        return -1;
+
+    checkpoint_restore(param, &saved);
+    param->resume = 1;
+
+    return 0;
+}
+
+int dfgen_param_prepare(param_t *param)
+{
+    if (!param) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int64_t filesize = param->filesize;
+    param->fixed_part_size     = filesize * param->fixed_ratio / 100;
+    param->non_fixed_part_size = filesize - param->fixed_part_size;
+
+    if (param->dict_path && param->overlap < 0)
+        param->overlap = DEFAULT_OVERLAP;
+
+    /* the stream is written in file order, and stdout only carries data */
+    if (param_is_stream(param)) {
+        if (param->threads > 1)
+            fprintf(stderr, "[WARN ]: streaming to stdout uses 1 thread instead of %d\n", param->threads);
+        param->threads = 1;
+        param->quiet   = 1;
+    }
+
+    return 0;
+}
+
+dfgen_t *dfgen_create(const param_t *param)
+{
+    if (!param) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    dfgen_t *gen = calloc(1, sizeof(dfgen_t));
+    if (!gen)
+        return NULL;
+
+    gen->param          = *param;
+    gen->param.output   = &gen->output;
+    gen->output.type    = -1;
+    gen->output.memfd   = -1;
+    gen->output.size    = -1;
+
+    return gen;
+}
+
+void dfgen_destroy(dfgen_t *gen)
+{
+    if (!gen)
+        return;
+
+    if (gen->output.memfd >= 0)
+        close(gen->output.memfd);
+    free(gen);
+}
+
+/* in-memory outputs have no file name, but the messages want one */
+static void set_output(dfgen_t *gen, int type, const char *name)
+{
+    gen->output.type = type;
+    if (!gen->param.filename)
+        gen->param.filename = (char *)name;
+}
+
+int dfgen_set_callback(dfgen_t *gen, dfgen_callback_t callback, void *arg)
+{
+    if (!gen || !callback) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    gen->output.callback = callback;
+    gen->output.arg      = arg;
+    set_output(gen, SINK_TYPE_CALLBACK, "(callback)");
+
+    return 0;
+}
+
+int dfgen_set_buffer(dfgen_t *gen, void *buffer, int64_t size)
+{
+    if (!gen || !buffer || size <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    gen->output.buffer      = buffer;
+    gen->output.buffer_size = size;
+    set_output(gen, SINK_TYPE_BUFFER, "(buffer)");
+
+    return 0;
+}
+
+int dfgen_set_memfd(dfgen_t *gen)
+{
+    if (!gen) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    set_output(gen, SINK_TYPE_MEMFD, "(memfd)");
+
+    return 0;
+}
+
+int64_t dfgen_max_size(const dfgen_t *gen)
+{
+    if (!gen) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return gen->param.filesize + (gen->param.enable_holes ? gen->param.holes_size : 0);
+}
+
+/* check and complete the settings right before they are used */
+static int dfgen_prepare(dfgen_t *gen)
+{
+    int num_err = dfgen_param_check(&gen->param);
+    if (num_err) {
+        fprintf(stderr, "[WARN ]: Total %d errors occur\n", num_err);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return dfgen_param_prepare(&gen->param);
+}
+
+int64_t dfgen_run(dfgen_t *gen)
+{
+    if (!gen) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (gen->output.memfd >= 0) {
+        close(gen->output.memfd);
+        gen->output.memfd = -1;
+    }
+    gen->output.size = -1;
+
+    if (dfgen_prepare(gen))
+        return -1;
+
+    if (gen->param.tree_path)
+        return generate_tree(&gen->param) ? -1 : gen->param.filesize;
+
+    if (gen->param.mutate_path)
+        return mutate_file(&gen->param) ? -1 : gen->output.size;
+
+    if (generate_file(&gen->param))
+        return -1;
+
+    return gen->output.size;
+}
+
+int dfgen_verify(dfgen_t *gen)
+{
+    if (!gen) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    gen->param.verify = 1;
+    if (dfgen_prepare(gen))
+        return -1;
+
+    return verify_file(&gen->param);
+}
+
+int dfgen_memfd(const dfgen_t *gen)
+{
+    if (!gen) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return gen->output.memfd;
+}
\ No newline at end of file
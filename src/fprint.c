@@ -0,0 +1,176 @@
+#include <string.h>
+#include "fprint.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define FPRINT_X86_64 1
+#endif
+
+#define CRC32C_POLY 0x82f63b78U
+
+static uint32_t crc32c_table[256];
+
+static void crc32c_init_table(void)
+{
+    for (uint32_t i = 0 ; i < 256; i++) {
+        uint32_t crc = i;
+        for (int k = 0 ; k < 8; k++)
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        crc32c_table[i] = crc;
+    }
+}
+
+static inline uint32_t crc32c_u8_sw(uint32_t crc, uint8_t v)
+{
+    return (crc >> 8) ^ crc32c_table[(crc ^ v) & 0xff];
+}
+
+static inline uint32_t crc32c_u64_sw(uint32_t crc, uint64_t v)
+{
+    for (int k = 0 ; k < 8; k++)
+        crc = crc32c_u8_sw(crc, (uint8_t)(v >> (8 * k)));
+    return crc;
+}
+
+/*
+ * An implementation hashes whole 16-byte blocks, the first half into lane a
+ * and the second half into lane b, and the bytes after the last block into
+ * lane a.
+ */
+typedef struct fprint_impl_t {
+    const char *name;
+    void      (*blocks)(uint32_t *a, uint32_t *b, const unsigned char *p, int64_t num_blocks);
+    uint32_t  (*bytes)(uint32_t a, const unsigned char *p, int64_t len);
+} fprint_impl_t;
+
+static void blocks_sw(uint32_t *a, uint32_t *b, const unsigned char *p, int64_t num_blocks)
+{
+    uint32_t la = *a, lb = *b;
+    uint64_t va, vb;
+
+    for (int64_t i = 0 ; i < num_blocks; i++, p += FPRINT_BLOCK_SIZE) {
+        memcpy(&va, p, 8);
+        memcpy(&vb, p + 8, 8);
+        la = crc32c_u64_sw(la, va);
+        lb = crc32c_u64_sw(lb, vb);
+    }
+
+    *a = la;
+    *b = lb;
+}
+
+static uint32_t bytes_sw(uint32_t a, const unsigned char *p, int64_t len)
+{
+    for (int64_t i = 0 ; i < len; i++)
+        a = crc32c_u8_sw(a, p[i]);
+    return a;
+}
+
+#ifdef FPRINT_X86_64
+/* two independent lanes hide the latency of the crc32 instruction */
+__attribute__((target("sse4.2")))
+static void blocks_sse42(uint32_t *a, uint32_t *b, const unsigned char *p, int64_t num_blocks)
+{
+    uint64_t la = *a, lb = *b;
+    uint64_t va, vb;
+
+    for (int64_t i = 0 ; i < num_blocks; i++, p += FPRINT_BLOCK_SIZE) {
+        memcpy(&va, p, 8);
+        memcpy(&vb, p + 8, 8);
+        la = _mm_crc32_u64(la, va);
+        lb = _mm_crc32_u64(lb, vb);
+    }
+
+    *a = (uint32_t)la;
+    *b = (uint32_t)lb;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t bytes_sse42(uint32_t a, const unsigned char *p, int64_t len)
+{
+    for (int64_t i = 0 ; i < len; i++)
+        a = _mm_crc32_u8(a, p[i]);
+    return a;
+}
+#endif
+
+static const fprint_impl_t fprint_sw = { "crc32c-table", blocks_sw, bytes_sw };
+#ifdef FPRINT_X86_64
+static const fprint_impl_t fprint_sse42 = { "crc32c-sse4.2", blocks_sse42, bytes_sse42 };
+#endif
+
+static const fprint_impl_t *fprint_impl = NULL;
+
+static const fprint_impl_t *fingerprint_impl(void)
+{
+    if (fprint_impl)
+        return fprint_impl;
+
+    crc32c_init_table();
+#ifdef FPRINT_X86_64
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        fprint_impl = &fprint_sse42;
+        return fprint_impl;
+    }
+#endif
+    fprint_impl = &fprint_sw;
+    return fprint_impl;
+}
+
+void fingerprint_begin(fingerprint_t *fp, int64_t length)
+{
+    fp->a        = ~0U;
+    fp->b        = ~(uint32_t)length;
+    fp->tail_len = 0;
+}
+
+void fingerprint_update(fingerprint_t *fp, const void *buf, int64_t len)
+{
+    const fprint_impl_t *impl = fingerprint_impl();
+    const unsigned char *p    = buf;
+
+    /* complete the block left over by the previous update */
+    if (fp->tail_len > 0) {
+        int64_t fill = FPRINT_BLOCK_SIZE - fp->tail_len;
+        if (fill > len)
+            fill = len;
+        memcpy(fp->tail + fp->tail_len, p, fill);
+        fp->tail_len += fill;
+        p            += fill;
+        len          -= fill;
+        if (fp->tail_len < FPRINT_BLOCK_SIZE)
+            return;
+        impl->blocks(&fp->a, &fp->b, fp->tail, 1);
+        fp->tail_len = 0;
+    }
+
+    int64_t num_blocks = len / FPRINT_BLOCK_SIZE;
+    impl->blocks(&fp->a, &fp->b, p, num_blocks);
+    p   += num_blocks * FPRINT_BLOCK_SIZE;
+    len -= num_blocks * FPRINT_BLOCK_SIZE;
+
+    memcpy(fp->tail, p, len);
+    fp->tail_len = len;
+}
+
+uint64_t fingerprint_end(fingerprint_t *fp)
+{
+    uint32_t a = fingerprint_impl()->bytes(fp->a, fp->tail, fp->tail_len);
+
+    return ((uint64_t)~a << 32) | (uint32_t)~fp->b;
+}
+
+uint64_t fingerprint(const void *buf, int64_t len)
+{
+    fingerprint_t fp;
+
+    fingerprint_begin(&fp, len);
+    fingerprint_update(&fp, buf, len);
+    return fingerprint_end(&fp);
+}
+
+const char *fingerprint_name(void)
+{
+    return fingerprint_impl()->name;
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "futil.h"
+
+#define min(a,b) (((a)>(b))?(b):(a))
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+int pwrite_full(int fd, const void *buf, int64_t len, int64_t offset)
+{
+    const char *curptr = buf;
+
+    while (len > 0) {
+        ssize_t ret = pwrite(fd, curptr, len, offset);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        curptr += ret;
+        len    -= ret;
+        offset += ret;
+    }
+
+    return 0;
+}
+
+/*
+ * Write <len> bytes at <offset> of the endless repetition of the <period>
+ * bytes of <buf>, starting <skew> bytes into it: byte i of the range is
+ * buf[(skew + i) % period]. Every pwritev() hands the same buffer over up
+ * to IOV_MAX times, so a repeated pattern costs a syscall per GB or so
+ * rather than one per copy.
+ */
+static int pwritev_repeat(int fd, const char *buf, int64_t period, int64_t skew, int64_t len, int64_t offset)
+{
+    struct iovec iov[IOV_MAX];
+
+    while (len > 0) {
+        int64_t batch = 0;
+        int     count = 0;
+
+        for (int64_t pos = skew; count < IOV_MAX && batch < len; pos = 0) {
+            int64_t length = min(period - pos, min(len - batch, FUTIL_MAX_RW_SIZE - batch));
+            if (length <= 0)
+                break;
+            iov[count].iov_base = (void *)(buf + pos);
+            iov[count].iov_len  = length;
+            count++;
+            batch += length;
+        }
+
+        ssize_t ret = pwritev(fd, iov, count, offset);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        skew    = (skew + ret) % period;
+        len    -= ret;
+        offset += ret;
+    }
+
+    return 0;
+}
+
+/*
+ * Duplicate the first <period> bytes of [ offset, offset + len ), already
+ * written, over the rest of it inside the kernel, doubling the copy every
+ * time. Returns the bytes in place, a whole number of periods unless all
+ * of <len>, which fall short of <len> when the file system can not copy.
+ */
+static int64_t copy_repeat(int fd, int64_t period, int64_t len, int64_t offset)
+{
+    int64_t done = period;
+
+    while (done < len && done % period == 0) {
+        loff_t  src = offset;
+        loff_t  dst = offset + done;
+        ssize_t ret = copy_file_range(fd, &src, fd, &dst, min(done, len - done), 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EXDEV || errno == EOPNOTSUPP || errno == ENOSYS || errno == EINVAL)
+                break;
+            return -1;
+        }
+        if (ret == 0)
+            break;
+        done += ret;
+    }
+
+    return done;
+}
+
+int pwrite_repeat(int fd, const void *buf, int64_t period, int64_t skew, int64_t len, int64_t offset, int flags)
+{
+    int64_t done = 0;
+
+    if (period <= 0 || skew < 0 || skew >= period) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((flags & FUTIL_REPEAT_COPY) && len >= 2 * period) {
+        /* one period by hand, the others copied from it */
+        if (pwritev_repeat(fd, buf, period, skew, period, offset))
+            return -1;
+        done = copy_repeat(fd, period, len, offset);
+        if (done < 0)
+            return -1;
+        /* whatever a short copy left unaligned is written again */
+        if (done < len)
+            done = done / period * period;
+    }
+
+    return pwritev_repeat(fd, buf, period, (skew + done) % period, len - done, offset + done);
+}
+
+/* page-aligned, pre-faulted buffer, released with free() */
+void *alloc_aligned(int64_t size, int64_t alignment)
+{
+    void *ptr = NULL;
+
+    if (size <= 0 || alignment <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (posix_memalign(&ptr, alignment, size)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(ptr, 0, size);
+
+    return ptr;
+}
+
+/* allocate the blocks of [ offset, offset + len ) up front, the file grows over them */
+int prealloc_range(int fd, int64_t offset, int64_t len)
+{
+    while (fallocate(fd, 0, offset, len)) {
+        if (errno != EINTR)
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Write-behind: start the writeback of the range just written, and wait
+ * for the one before it, so the dirty pages of the file stay bounded by
+ * two ranges instead of growing until the kernel throttles the writer.
+ */
+int sync_behind(int fd, int64_t offset, int64_t len, int64_t prev_offset, int64_t prev_len)
+{
+    if (len > 0 && sync_file_range(fd, offset, len, SYNC_FILE_RANGE_WRITE))
+        return -1;
+
+    if (prev_len > 0 && sync_file_range(fd, prev_offset, prev_len,
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER))
+        return -1;
+
+    return 0;
+}
+
+/* fdatasync() the file at <path>, once every descriptor that wrote it is closed */
+int sync_path(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    int error = fdatasync(fd);
+    if (close(fd))
+        error = -1;
+
+    return error;
+}
+
+/* evict the file at <path> from the page cache, writing back what is still dirty first */
+int drop_cache_path(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    int error = 0;
+    if (sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER))
+        error = -1;
+    if (!error && (errno = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED)))
+        error = -1;
+    if (close(fd))
+        error = -1;
+
+    return error;
+}
\ No newline at end of file
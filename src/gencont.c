@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "gencont.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GENCONT_X86 1
+#endif
+
+#define GENCONT_WORD_SIZE 4
+
+#define GENCONT_MUL0 0x9e3779b1U
+#define GENCONT_MUL1 0x85ebca77U
+#define GENCONT_MUL2 0x85ebca6bU
+#define GENCONT_MUL3 0xc2b2ae35U
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void prng_seed(prng_t *prng, uint64_t seed)
+{
+    for (int i = 0 ; i < 4; i++)
+        prng->s[i] = splitmix64(&seed);
+}
+
+uint64_t prng_next(prng_t *prng)
+{
+    uint64_t *s      = prng->s;
+    uint64_t  result = rotl(s[1] * 5, 7) * 9;
+    uint64_t  t      = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3]  = rotl(s[3], 45);
+
+    return result;
+}
+
+/* uniform in [ 0, range ) without modulo bias (Lemire's multiply-and-reject) */
+uint64_t prng_bounded(prng_t *prng, uint64_t range)
+{
+    if (range == 0)
+        return 0;
+
+    unsigned __int128 m = (unsigned __int128)prng_next(prng) * range;
+    uint64_t          l = (uint64_t)m;
+
+    if (l < range) {
+        uint64_t threshold = -range % range;
+        while (l < threshold) {
+            m = (unsigned __int128)prng_next(prng) * range;
+            l = (uint64_t)m;
+        }
+    }
+
+    return m >> 64;
+}
+
+uint64_t gencont_derive(uint64_t seed, uint64_t stream)
+{
+    uint64_t x = seed ^ (stream * 0xd6e8feb86659fd93ULL);
+    return splitmix64(&x);
+}
+
+uint64_t gencont_hash64(uint64_t key, uint64_t counter)
+{
+    uint64_t x = key ^ rotl(counter, 32);
+    x += counter;
+    return splitmix64(&x);
+}
+
+/*
+ * The counter-based kernel works on 32-bit words so that it maps onto the
+ * 32-bit lane multiplies available since SSE4.1. Word j of a stream is
+ *
+ *     fmix32(fmix32(lo(j) * C0 + k0) ^ (hi(j) * C1 + k1))
+ *
+ * which is a bijection of lo(j) for a given hi(j): no word repeats inside a
+ * 16 GB window, and the bytes look uniformly random to compressors.
+ */
+static inline uint32_t fmix32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= GENCONT_MUL2;
+    x ^= x >> 13;
+    x *= GENCONT_MUL3;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline uint32_t word_at(uint64_t key, uint64_t j)
+{
+    uint32_t x = (uint32_t)j * GENCONT_MUL0 + (uint32_t)key;
+    x  = fmix32(x);
+    x ^= (uint32_t)(j >> 32) * GENCONT_MUL1 + (uint32_t)(key >> 32);
+    return fmix32(x);
+}
+
+/* fill <nwords> whole words starting at word index <j> */
+typedef void (*gencont_kernel_t)(uint64_t key, uint64_t j, char *out, int64_t nwords);
+
+static void kernel_scalar(uint64_t key, uint64_t j, char *out, int64_t nwords)
+{
+    for (int64_t i = 0 ; i < nwords; i++) {
+        uint32_t w = word_at(key, j + i);
+        memcpy(out + i * GENCONT_WORD_SIZE, &w, GENCONT_WORD_SIZE);
+    }
+}
+
+#ifdef GENCONT_X86
+__attribute__((target("sse4.1")))
+static inline __m128i fmix32_sse4(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = _mm_mullo_epi32(x, _mm_set1_epi32(GENCONT_MUL2));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 13));
+    x = _mm_mullo_epi32(x, _mm_set1_epi32(GENCONT_MUL3));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    return x;
+}
+
+__attribute__((target("sse4.1")))
+static void kernel_sse4(uint64_t key, uint64_t j, char *out, int64_t nwords)
+{
+    const int64_t lanes = 4;
+    int64_t       i     = 0;
+
+    while (i + lanes <= nwords) {
+        uint64_t base = j + i;
+        /* the high half must be shared by all lanes of a vector */
+        if ((uint32_t)base > UINT32_MAX - lanes) {
+            kernel_scalar(key, base, out + i * GENCONT_WORD_SIZE, lanes);
+            i += lanes;
+            continue;
+        }
+
+        __m128i lo = _mm_add_epi32(_mm_set1_epi32((uint32_t)base), _mm_setr_epi32(0, 1, 2, 3));
+        __m128i hi = _mm_set1_epi32((uint32_t)(base >> 32) * GENCONT_MUL1 + (uint32_t)(key >> 32));
+        __m128i x  = _mm_add_epi32(_mm_mullo_epi32(lo, _mm_set1_epi32(GENCONT_MUL0)), _mm_set1_epi32((uint32_t)key));
+        x = fmix32_sse4(x);
+        x = fmix32_sse4(_mm_xor_si128(x, hi));
+        _mm_storeu_si128((__m128i *)(out + i * GENCONT_WORD_SIZE), x);
+        i += lanes;
+    }
+
+    kernel_scalar(key, j + i, out + i * GENCONT_WORD_SIZE, nwords - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fmix32_avx2(__m256i x)
+{
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(GENCONT_MUL2));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 13));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(GENCONT_MUL3));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    return x;
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2(uint64_t key, uint64_t j, char *out, int64_t nwords)
+{
+    const int64_t lanes = 8;
+    int64_t       i     = 0;
+
+    __m256i step = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i mul0 = _mm256_set1_epi32(GENCONT_MUL0);
+    __m256i k0   = _mm256_set1_epi32((uint32_t)key);
+
+    while (i + lanes <= nwords) {
+        uint64_t base = j + i;
+        if ((uint32_t)base > UINT32_MAX - lanes) {
+            kernel_scalar(key, base, out + i * GENCONT_WORD_SIZE, lanes);
+            i += lanes;
+            continue;
+        }
+
+        __m256i lo = _mm256_add_epi32(_mm256_set1_epi32((uint32_t)base), step);
+        __m256i hi = _mm256_set1_epi32((uint32_t)(base >> 32) * GENCONT_MUL1 + (uint32_t)(key >> 32));
+        __m256i x  = _mm256_add_epi32(_mm256_mullo_epi32(lo, mul0), k0);
+        x = fmix32_avx2(x);
+        x = fmix32_avx2(_mm256_xor_si256(x, hi));
+        _mm256_storeu_si256((__m256i *)(out + i * GENCONT_WORD_SIZE), x);
+        i += lanes;
+    }
+
+    kernel_scalar(key, j + i, out + i * GENCONT_WORD_SIZE, nwords - i);
+}
+#endif
+
+typedef struct gencont_impl_t {
+    const char       *name;
+    gencont_kernel_t  kernel;
+    int             (*supported)(void);
+} gencont_impl_t;
+
+static int always_supported(void)
+{
+    return 1;
+}
+
+#ifdef GENCONT_X86
+static int sse4_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+}
+
+static int avx2_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+/* ordered from the most to the least preferred implementation */
+static const gencont_impl_t gencont_impls[] = {
+#ifdef GENCONT_X86
+    { "avx2",   kernel_avx2,   avx2_supported   },
+    { "sse4",   kernel_sse4,   sse4_supported   },
+#endif
+    { "scalar", kernel_scalar, always_supported },
+};
+
+static const gencont_impl_t *gencont_impl = NULL;
+static pthread_once_t        gencont_once = PTHREAD_ONCE_INIT;
+
+/* whether the content engine <name> exists and runs on this CPU */
+int gencont_supported(const char *name)
+{
+    for (int i = 0 ; i < sizeof(gencont_impls)/sizeof(gencont_impls[0]); i++) {
+        if (strcmp(name, gencont_impls[i].name) == 0)
+            return gencont_impls[i].supported();
+    }
+    return 0;
+}
+
+int gencont_select(const char *name)
+{
+    int auto_select = !name || strcmp(name, "auto") == 0;
+
+    for (int i = 0 ; i < sizeof(gencont_impls)/sizeof(gencont_impls[0]); i++) {
+        if (!auto_select && strcmp(name, gencont_impls[i].name) != 0)
+            continue;
+        if (!gencont_impls[i].supported()) {
+            if (!auto_select) {
+                fprintf(stderr, "[ERROR]: content engine %s is not supported by this CPU\n", name);
+                errno = ENOTSUP;
+                return -1;
+            }
+            continue;
+        }
+        gencont_impl = &gencont_impls[i];
+        return 0;
+    }
+
+    fprintf(stderr, "[ERROR]: unknown content engine %s\n", name);
+    errno = EINVAL;
+    return -1;
+}
+
+/* picks the best engine unless one was forced, once for all the threads */
+static void gencont_init(void)
+{
+    if (!gencont_impl)
+        gencont_select(NULL);
+}
+
+const char *gencont_name(void)
+{
+    pthread_once(&gencont_once, gencont_init);
+    return gencont_impl->name;
+}
+
+static void gencont_fill_random(uint64_t key, int64_t offset, void *buf, int64_t len)
+{
+    char *out = buf;
+
+    if (len <= 0)
+        return;
+
+    pthread_once(&gencont_once, gencont_init);
+
+    uint64_t j    = offset / GENCONT_WORD_SIZE;
+    int64_t  skew = offset % GENCONT_WORD_SIZE;
+
+    /* leading partial word */
+    if (skew) {
+        uint32_t w     = word_at(key, j++);
+        int64_t  bytes = GENCONT_WORD_SIZE - skew;
+        if (bytes > len)
+            bytes = len;
+        memcpy(out, (char *)&w + skew, bytes);
+        out += bytes;
+        len -= bytes;
+    }
+
+    int64_t nwords = len / GENCONT_WORD_SIZE;
+    gencont_impl->kernel(key, j, out, nwords);
+    out += nwords * GENCONT_WORD_SIZE;
+    len -= nwords * GENCONT_WORD_SIZE;
+    j   += nwords;
+
+    /* trailing partial word */
+    if (len > 0) {
+        uint32_t w = word_at(key, j);
+        memcpy(out, &w, len);
+    }
+}
+
+/*
+ * Compressible content.
+ *
+ * The content is cut into blocks of GENCONT_BLOCK_SIZE bytes. Each block
+ * starts with a run of random literals, as many as 1 / ratio of the block,
+ * and the rest of it repeats a token picked from a small dictionary of
+ * words. A compressor stores the literals as they are and the repeated
+ * token for almost nothing, so the ratio of the whole lands close to the
+ * target. The repeated part of every token is precomputed as a whole
+ * pattern block, so filling a block is one random fill and one memcpy, and
+ * any byte is still a pure function of (key, ratio, offset).
+ *
+ * The ratio is passed with every fill rather than kept here, so that runs
+ * with different ratios can share the process. The pattern blocks do not
+ * depend on it, they are built once and only read afterwards.
+ */
+
+#define GENCONT_BLOCK_SIZE     4096
+#define GENCONT_NUM_TOKENS     256
+#define GENCONT_TOKEN_MAX      64
+#define GENCONT_BLOCK_OVERHEAD 24
+
+static const char *gencont_words[] = {
+    "the ", "data ", "block ", "file ", "of ", "and ", "record ", "index ",
+    "value ", "time ", "user ", "id=", "status ", "error ", "ok ", "name ",
+    "size ", "type ", "backup ", "chunk ", "to ", "from ", "in ", "is ",
+    "page ", "offset ", "key ", "log ", "request ", "session ", "node ", "\n",
+};
+
+static char           gencont_patterns[GENCONT_NUM_TOKENS * GENCONT_BLOCK_SIZE];
+static pthread_once_t gencont_patterns_once = PTHREAD_ONCE_INIT;
+
+/* the same dictionary for every run, so that equal settings give equal files */
+static void gencont_patterns_init(void)
+{
+    prng_t prng;
+    prng_seed(&prng, GENCONT_NUM_TOKENS);
+    for (int t = 0 ; t < GENCONT_NUM_TOKENS; t++) {
+        char token[GENCONT_TOKEN_MAX];
+        int  length = 0;
+        int  words  = 1 + prng_bounded(&prng, 6);
+        for (int w = 0 ; w < words; w++) {
+            const char *word = gencont_words[prng_bounded(&prng, sizeof(gencont_words)/sizeof(gencont_words[0]))];
+            int         n    = strlen(word);
+            if (length + n > GENCONT_TOKEN_MAX)
+                break;
+            memcpy(token + length, word, n);
+            length += n;
+        }
+        char *pattern = gencont_patterns + t * GENCONT_BLOCK_SIZE;
+        for (int i = 0 ; i < GENCONT_BLOCK_SIZE; i++)
+            pattern[i] = token[i % length];
+    }
+}
+
+/* random bytes at the start of every block for a compression ratio of <ratio> */
+static int64_t gencont_literals(double ratio)
+{
+    if (ratio <= 1.0)
+        return GENCONT_BLOCK_SIZE;
+
+    /* what a compressor spends on a block besides the literals, averaged over gzip, zstd and lz4 */
+    int64_t literals = (int64_t)(GENCONT_BLOCK_SIZE / ratio + 0.5) - GENCONT_BLOCK_OVERHEAD;
+    return literals < 1 ? 1 : literals;
+}
+
+static void gencont_fill_compressible(uint64_t key, int64_t literals, int64_t offset, char *out, int64_t len)
+{
+    pthread_once(&gencont_patterns_once, gencont_patterns_init);
+
+    while (len > 0) {
+        int64_t block = offset / GENCONT_BLOCK_SIZE;
+        int64_t pos   = offset % GENCONT_BLOCK_SIZE;
+        int64_t bytes;
+
+        if (pos < literals) {
+            bytes = literals - pos;
+            if (bytes > len)
+                bytes = len;
+            gencont_fill_random(key, offset, out, bytes);
+        }
+        else {
+            const char *pattern = gencont_patterns +
+                (gencont_hash64(key, block) % GENCONT_NUM_TOKENS) * GENCONT_BLOCK_SIZE;
+            bytes = GENCONT_BLOCK_SIZE - pos;
+            if (bytes > len)
+                bytes = len;
+            memcpy(out, pattern + pos, bytes);
+        }
+
+        out    += bytes;
+        offset += bytes;
+        len    -= bytes;
+    }
+}
+
+void gencont_fill(uint64_t key, double ratio, int64_t offset, void *buf, int64_t len)
+{
+    int64_t literals = gencont_literals(ratio);
+
+    if (literals < GENCONT_BLOCK_SIZE)
+        gencont_fill_compressible(key, literals, offset, buf, len);
+    else
+        gencont_fill_random(key, offset, buf, len);
+}
\ No newline at end of file
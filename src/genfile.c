@@ -1,25 +1,233 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "genfile.h"
+#include "alias.h"
+#include "checkpoint.h"
 #include "chunk.h"
+#include "chunkdict.h"
+#include "dedupidx.h"
+#include "dfgen.h"
+#include "fprint.h"
+#include "futil.h"
+#include "gencont.h"
+#include "rate.h"
+#include "seqsample.h"
+#include "sink.h"
+#include "stats.h"
+#include "tpool.h"
 
 #define min(a,b) (((a)>(b))?(b):(a))
+#define max(a,b) (((a)<(b))?(b):(a))
 
-static int cmp_int(const void *lhs, const void *rhs)
+/* size of the byte range handed to a worker, and of the pieces it is generated in */
+#define GENFILE_UNIT_SIZE (4LL * 1024 * 1024)
+/* largest fixed range, when the sink writes a repeated buffer in a few syscalls */
+#define GENFILE_FIXED_BATCH_SIZE (1LL * 1024 * 1024 * 1024)
+/* alignment of the fixed pattern pool, so that it can sit on huge pages */
+#define GENFILE_HUGEPAGE_SIZE (2LL * 1024 * 1024)
+/* smallest piece, when the pieces shrink to fit under --mem-limit */
+#define GENFILE_MIN_PIECE_SIZE (64LL * 1024)
+/* what a sink buffer takes on top of its piece: skew in front, a partial block behind */
+#define GENFILE_BUFFER_SLACK (2 * FUTIL_DIRECT_ALIGNMENT)
+
+enum RANGE_KIND {
+    RANGE_KIND_FIXED     = DFGEN_KIND_FIXED,
+    RANGE_KIND_NON_FIXED = DFGEN_KIND_NON_FIXED,
+    RANGE_KIND_HOLE      = DFGEN_KIND_HOLE,
+    RANGE_KIND_LAST,
+};
+
+static const char *range_kind_names[] = {
+    [RANGE_KIND_FIXED]     = "fixed",
+    [RANGE_KIND_NON_FIXED] = "non fixed",
+    [RANGE_KIND_HOLE]      = "holes",
+};
+
+/*
+ * The variable-size chunks of the non-fixed part. With a chunk dictionary,
+ * every chunk is drawn from it with a probability of --overlap percent,
+ * and then has the size of the dictionary chunks.
+ */
+typedef struct chunk_seq_t {
+    prng_t  sizes;
+    prng_t  picks;
+} chunk_seq_t;
+
+/* a hole of <length> bytes inserted right before payload byte <offset> */
+typedef struct hole_t {
+    int64_t offset;
+    int64_t length;
+} hole_t;
+
+typedef struct hole_plan_t {
+    param_t     *param;
+    seqsample_t  fixed;         /* fixed chunks followed by a hole */
+    int64_t      num_fixed;
+    int64_t      fixed_done;
+    int64_t      fixed_hole_size;
+    int64_t      fixed_last_hole_size;
+    int64_t      num_non_fixed;
+    int64_t      non_fixed_done;
+    int64_t      non_fixed_hole_size;
+    int64_t      non_fixed_last_hole_size;
+    int64_t      payload;       /* payload offset of the next non-fixed hole */
+    chunk_seq_t  chunks;
+    const chunk_dict_t *dict;
+} hole_plan_t;
+
+/*
+ * Where the walk of the layout stands: the next payload byte and its file
+ * offset, the chunk and hole streams and the next hole. Plain data, so a
+ * checkpoint can save it and a resumed run carry on from it.
+ */
+typedef struct layout_pos_t {
+    int64_t      payload;
+    int64_t      file_offset;
+    chunk_seq_t  chunks;
+    hole_plan_t  holes;
+    hole_t       hole;          /* next hole, valid while has_hole */
+    int          has_hole;
+} layout_pos_t;
+
+/* a range submitted with --checkpoint, and the position of the layout right after it */
+typedef struct progress_slot_t {
+    int          done;
+    layout_pos_t pos;
+} progress_slot_t;
+
+/*
+ * --checkpoint: ranges complete in any order, the file is written up to
+ * <durable.file_offset> once every range before that point is.
+ */
+typedef struct progress_t {
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;          /* a slot of the ring is free again */
+    progress_slot_t *slots;         /* ring of the ranges in flight, by sequence number */
+    int64_t          num_slots;
+    int64_t          submitted;
+    int64_t          completed;     /* ranges before it all done */
+    layout_pos_t     durable;
+    int64_t          checkpointed;  /* file offset of the last checkpoint */
+} progress_t;
+
+typedef struct genctx_t {
+    param_t      *param;
+    sink_t       *sink;
+    int           error;
+    char         *fixed_buffer;     /* NULL when the fixed chunks are generated piece by piece */
+    int64_t       fixed_buffer_size;
+    int64_t       num_patterns;     /* distinct fixed chunks */
+    alias_t      *patterns;         /* pattern of every fixed chunk, NULL with a single one */
+    uint64_t      pattern_key;
+    int64_t       piece_size;       /* largest slice of a range held in memory at once */
+    uint64_t      fixed_key;
+    uint64_t      non_fixed_key;
+    layout_pos_t  pos;
+    progress_t   *progress;         /* NULL without --checkpoint */
+    dedup_index_t *index;
+    uint64_t     *pattern_fingerprints;
+    uint64_t     *patterns_used;    /* patterns present in the file, for the index */
+    uint64_t      fixed_tail_fingerprint;
+    int64_t       num_records;
+    dedup_summary_t summary;
+    stats_t      *stats;
+    rate_t       *rate;             /* --rate and --duration, NULL without them */
+    int           expired;          /* --duration is over, nothing more gets written */
+    chunk_dict_t *dict;
+    uint64_t     *dict_used;        /* dictionary chunks already in the file, for the index */
+    int64_t       repeated_bytes;   /* dictionary chunks copied more than once */
+
+    /* verify mode: ranges are read back and compared instead of written */
+    int           verify;
+    int           fd;
+    int64_t       file_size;
+    char        **buffers;          /* expected and actual content, per worker */
+    int64_t       first_mismatch[RANGE_KIND_LAST];
+    int64_t       mismatch_bytes[RANGE_KIND_LAST];
+} genctx_t;
+
+/* a disjoint range of the target file, filled and written by one worker */
+typedef struct genjob_t {
+    genctx_t *ctx;
+    int       kind;
+    int64_t   payload_offset;
+    int64_t   file_offset;
+    int64_t   length;
+    chunk_seq_t chunks;     /* chunk stream positioned at payload_offset */
+    int64_t   first_record; /* index record of the first chunk of the range */
+    int64_t   num_chunks;
+    int64_t   seq;          /* order of submission, for --checkpoint */
+} genjob_t;
+
+#define RECORD_BATCH 64
+
+/* dedup index records of one range, flushed in batches */
+typedef struct record_batch_t {
+    dedup_index_t  *index;
+    int64_t         first;
+    int             count;
+    dedup_record_t  records[RECORD_BATCH];
+} record_batch_t;
+
+/* the non-fixed chunk being generated, carried from one piece of a range to the next */
+typedef struct chunk_cursor_t {
+    chunk_seq_t   chunks;
+    int64_t       end;      /* payload end of the range */
+    int64_t       offset;   /* payload offset of the chunk */
+    int64_t       left;     /* bytes of the chunk still to generate */
+    int64_t       pick;     /* dictionary chunk it copies, or -1 */
+    fingerprint_t fp;
+} chunk_cursor_t;
+
+static inline void seed_chunk_sizes(prng_t *prng, param_t *param)
+{
+    prng_seed(prng, gencont_derive(param->seed, GENCONT_STREAM_CHUNK_SIZE));
+}
+
+static inline void chunk_seq_init(chunk_seq_t *seq, param_t *param)
+{
+    seed_chunk_sizes(&seq->sizes, param);
+    prng_seed(&seq->picks, gencont_derive(param->seed, GENCONT_STREAM_DICT_PICKS));
+}
+
+/* size of the next chunk, *pick is the dictionary chunk it copies or -1 */
+static inline int64_t chunk_seq_next(chunk_seq_t *seq, param_t *param, const chunk_dict_t *dict, int64_t *pick)
+{
+    *pick = -1;
+
+    if (dict && prng_bounded(&seq->picks, 100) < param->overlap) {
+        *pick = prng_bounded(&seq->picks, dict->num_chunks);
+        return dict->chunk_size;
+    }
+
+    return random_chunk_size(&seq->sizes, param->chunk_size_min, param->chunk_size_max);
+}
+
+/* pattern of fixed chunk <chunk_idx>: a pure function of the index, so any range can be generated alone */
+static inline int64_t fixed_pattern(const genctx_t *ctx, int64_t chunk_idx)
 {
-    return *(int *)lhs > *(int *)rhs;
+    if (!ctx->patterns)
+        return 0;
+    return alias_sample(ctx->patterns, gencont_hash64(ctx->pattern_key, chunk_idx));
 }
 
-static inline int64_t random_chunk_size(int64_t min, int64_t max)
+/* pattern 0 keeps the content stream of the single fixed chunk of earlier versions */
+static inline uint64_t fixed_pattern_key(const genctx_t *ctx, int64_t pattern)
 {
-    if (max == min)
-        return max;
-    return min + (rand() % (max-min));
+    return pattern == 0 ? ctx->fixed_key : gencont_derive(ctx->fixed_key, pattern);
 }
 
-static int populate_data_for_fixed_part(FILE *fp, param_t *param)
+static int populate_data_for_fixed_part(FILE *fp, param_t *param, stats_t *stats)
 {
     if (!fp || !param) {
         errno = EINVAL;
@@ -30,34 +238,53 @@ static int populate_data_for_fixed_part(FILE *fp, param_t *param)
     if (param->fixed_part_size <= 0)
         return 0;
 
-    int64_t processed_bytes = 0;
     int64_t bytes_to_write  = param->fixed_part_size;
-    int64_t available_bytes = 0;
-    int64_t written_bytes   = 0;
     int64_t chunksize       = param->chunk_size;
+    int     error           = 0;
     
-    chunk_t *fixed_chunk = chunk_create(chunksize);
+    chunk_t *fixed_chunk = chunk_create(chunksize, gencont_derive(param->seed, GENCONT_STREAM_FIXED), param->compress_ratio, 0);
     if (!fixed_chunk) {
         fprintf(stderr, "[ERROR]: failed to create fixed chunk\n");
         return -1;
     }
 
-    while (processed_bytes < bytes_to_write) {
-        available_bytes = min(bytes_to_write - processed_bytes, chunksize);
-        written_bytes   = fwrite(fixed_chunk->data, 1, available_bytes, fp);
-        if (available_bytes != written_bytes)
-            fprintf(stderr, "[WARN ]: should write %ld bytes, but has wrote %ld bytes", available_bytes, written_bytes);
-        processed_bytes += written_bytes;
+    /*
+     * The fixed part is the chunk over and over: lay a unit of copies of it
+     * out once, write that with batches of iovecs all pointing at it (or
+     * copy it in the kernel with --copy-range) behind the back of stdio,
+     * then move the stream past it.
+     */
+    int64_t period = max(GENFILE_UNIT_SIZE / chunksize, 1) * chunksize;
+    char   *unit   = malloc(period);
+    if (!unit) {
+        fprintf(stderr, "[ERROR]: failed to create fixed chunk\n");
+        chunk_destroy(fixed_chunk);
+        return -1;
     }
+    for (int64_t pos = 0 ; pos < period; pos += chunksize)
+        memcpy(unit + pos, fixed_chunk->data, chunksize);
 
-    free(fixed_chunk);
+    uint64_t start = stats_now();
+    if (fflush(fp) ||
+        pwrite_repeat(fileno(fp), unit, period, 0, bytes_to_write, 0,
+                      param->copy_range ? FUTIL_REPEAT_COPY : 0) ||
+        fseeko(fp, bytes_to_write, SEEK_SET)) {
+        fprintf(stderr, "[ERROR]: failed to write the fixed part: %s\n", strerror(errno));
+        error = -1;
+    }
+    stats_add_write(stats, 0, stats_now() - start);
+    if (!error)
+        stats_add_data(stats, 0, bytes_to_write, (bytes_to_write + chunksize - 1) / chunksize);
 
-    return 0;
+    free(unit);
+    chunk_destroy(fixed_chunk);
+
+    return error;
 }
 
-static int populate_data_for_non_fixed_part(FILE *fp, param_t *param)
+static int populate_data_for_non_fixed_part(FILE *fp, param_t *param, chunk_pool_t *chunk_pool, stats_t *stats)
 {
-    if (!fp || !param) {
+    if (!fp || !param || !chunk_pool) {
         errno = EINVAL;
         fprintf(stderr, "[ERROR]: populate_data_for_non_fixed_part: %s\n", strerror(errno));
         return -1;
@@ -72,21 +299,30 @@ static int populate_data_for_non_fixed_part(FILE *fp, param_t *param)
     int64_t written_bytes   = 0;
     int64_t min_chunksize   = param->chunk_size_min;
     int64_t max_chunksize   = param->chunk_size_max;
+    uint64_t key            = gencont_derive(param->seed, GENCONT_STREAM_NON_FIXED);
+    prng_t   sizes;
 
     chunk_t *chunk = NULL;
 
+    seed_chunk_sizes(&sizes, param);
+
     while (processed_bytes < bytes_to_write) {
-        int64_t size = random_chunk_size(min_chunksize, max_chunksize);
-        chunk = chunk_create(size);
+        int64_t size = random_chunk_size(&sizes, min_chunksize, max_chunksize);
+        available_bytes = min(bytes_to_write - processed_bytes, size);
+        uint64_t start  = stats_now();
+        chunk = chunk_pool_get(chunk_pool, available_bytes, key, param->compress_ratio, param->fixed_part_size + processed_bytes);
         if (!chunk) {
             fprintf(stderr, "[ERROR]: failed to create random chunk\n");
             return -1;
         }
-        available_bytes = min(bytes_to_write - processed_bytes, size);
+        uint64_t generated = stats_now();
+        stats_add_time(stats, 0, STATS_PHASE_GENERATE, generated - start);
         written_bytes = fwrite(chunk->data, 1, available_bytes, fp);
+        stats_add_write(stats, 0, stats_now() - generated);
         if (written_bytes != available_bytes)
             fprintf(stderr, "[WARN ]: should write %ld bytes, but has wrote %ld bytes", available_bytes, written_bytes);
         processed_bytes += written_bytes;
+        stats_add_data(stats, 0, written_bytes, 1);
         chunk_destroy(chunk);
         chunk = NULL;
     }
@@ -94,154 +330,77 @@ static int populate_data_for_non_fixed_part(FILE *fp, param_t *param)
     return 0;
 }
 
-static int append_holes_from_temp_file_to_file(FILE *src, FILE *tar, param_t *param)
+static void report_chunk_pools(param_t *param, chunk_pool_t **pools, int num_pools)
 {
-    if (!src || !tar || !param) {
-        errno = EINVAL;
-        return -1;
-    }
+    uint64_t allocs_avoided = 0;
 
-    if (fseek(src, 0, SEEK_SET)) {
-        fprintf(stderr, "[ERROR]: failed to fseek the temp file\n");
-        return -1;
-    }
+    for (int i = 0 ; i < num_pools; i++)
+        allocs_avoided += chunk_pool_allocs_avoided(pools[i]);
 
-    if (fseek(tar, 0, SEEK_SET)) {
-        fprintf(stderr, "[ERROR]: failed to fseek the target file\n");
-        return -1;
-    }
+    if (!param->quiet)
+        fprintf(stdout, "[INFO ]: %lu chunk allocations avoided by the chunk pool\n", allocs_avoided);
+}
 
-    int64_t chunksize            = param->chunk_size;
-    int     fixed_ratio          = param->fixed_ratio;
-    int     num_fixed_chunk      = param->fixed_part_size / chunksize;
-    int     num_holes            = param->num_holes;
-    int     num_holes_fixed      = fixed_ratio * num_holes / 100;
-    int     num_holes_non_fixed  = num_holes - num_holes_fixed;
-    int64_t fixed_holes_size     = param->holes_size * (num_holes_fixed) / (num_holes_fixed+num_holes_non_fixed);
-    int64_t non_fixed_holes_size = param->holes_size - fixed_holes_size;
+/* progress is reported every second, unless quiet */
+#define GENFILE_REPORT_INTERVAL_MS 1000
 
+static stats_t *start_stats(param_t *param, int num_workers)
+{
+    stats_t *stats = stats_create(param, num_workers, param->quiet ? 0 : GENFILE_REPORT_INTERVAL_MS);
+    if (!stats)
+        fprintf(stderr, "[WARN ]: failed to set up the run statistics: %s\n", strerror(errno));
+    return stats;
+}
 
-    /* determine where to append holes */
-    if (num_holes_fixed > 0) {
-        int     *holes_index  = calloc(num_holes_fixed, sizeof(int));
-        int      duplicate    = 0;
-        int      chunk_idx    = -1;
-
-        memset(holes_index, -1, num_holes_fixed*sizeof(int));
-
-        /* setup holes index */
-        for (int i = 0 ; i < num_holes_fixed; i++) {
-            duplicate = 0;
-            chunk_idx = rand() % num_fixed_chunk;
-            for (int j = 0 ; j < i ; j++) {
-                if (chunk_idx == holes_index[j]) {
-                    i--;
-                    duplicate = 1;
-                    break;
-                }
-            }
-            if (!duplicate) {
-                memcpy(&holes_index[i], &chunk_idx, sizeof(int));
-            }
-        }
-        qsort(holes_index, num_holes_fixed, sizeof(int), cmp_int);
-
-        /* copy fixed part and generating holes */
-        int64_t copied_fixed_bytes = 0;
-        int     fixed_hole_idx     = 0;
-        char    buffer[chunksize];
-        int64_t hole_size          = fixed_holes_size / num_holes_fixed;
-        int64_t last_hole_size     = fixed_holes_size - hole_size * num_holes_fixed + hole_size;
-
-        for (int i = 0 ; i < num_fixed_chunk; i++) {
-            fread(buffer, 1, chunksize, src);
-            fwrite(buffer, 1, chunksize, tar);
-            if (fixed_hole_idx < num_holes_fixed && holes_index[fixed_hole_idx] == i) {
-                if (fixed_hole_idx != num_holes_fixed-1)
-                    fseek(tar, hole_size, SEEK_CUR);
-                else
-                    fseek(tar, last_hole_size, SEEK_CUR);
-                fixed_hole_idx++;
-            }
-            copied_fixed_bytes += chunksize;
-        }
-        fread(buffer, 1, param->fixed_part_size - copied_fixed_bytes, src);
-        fwrite(buffer, 1, param->fixed_part_size - copied_fixed_bytes, tar);
-        free(holes_index);
-    }
-    else {
-        int64_t processed_bytes = 0;
-        int64_t bytes_to_write  = param->fixed_part_size;
-        int64_t written_bytes   = 0;
-        int64_t read_bytes      = 0;
-        int64_t available_bytes = 0;
-        char    buffer[chunksize];
-
-        while (processed_bytes < bytes_to_write) {
-            available_bytes = min(chunksize, bytes_to_write-processed_bytes);
-            read_bytes = fread(buffer, 1, available_bytes, src);
-            if (available_bytes != read_bytes)
-                fprintf(stderr, "[WARN ]: should read %ld bytes, but read only %ld bytes\n", available_bytes, read_bytes);
-            written_bytes = fwrite(buffer, 1, read_bytes, tar);
-            if (read_bytes != written_bytes)
-                fprintf(stderr, "[WARN ]: should write %ld bytes, but wrote only %ld bytes instead\n", read_bytes, written_bytes);
-            processed_bytes += written_bytes;
-        }
+static int finish_stats(param_t *param, stats_t *stats, int error)
+{
+    stats_finish(stats);
+
+    if (!error && !param->quiet)
+        stats_print(stats);
+
+    if (!error && param->stats_json && stats_write_json(stats, param->stats_json))
+        error = -1;
+
+    stats_destroy(stats);
+
+    return error;
+}
+
+/* --prealloc of [ offset, offset + length ), a file system that can not is only worth a warning */
+static int prealloc_data(param_t *param, int fd, int64_t offset, int64_t length)
+{
+    if (!prealloc_range(fd, offset, length))
+        return 0;
+
+    if (errno == EOPNOTSUPP) {
+        fprintf(stderr, "[WARN ]: the file system of %s can not preallocate, --prealloc is ignored\n", param->filename);
+        param->prealloc = 0;
+        return 0;
     }
 
-    /* copy non fixed part and generating holes */
-    if (num_holes_non_fixed > 0) {
-        int64_t num_holes_gen = 0;
-        int64_t non_fixed_hole_len = non_fixed_holes_size / num_holes_non_fixed;
-        int64_t last_hole_size     = non_fixed_holes_size - non_fixed_hole_len * num_holes_non_fixed + non_fixed_hole_len;
-        int64_t copied_non_fixed_bytes = 0;
-        int64_t non_fixed_bytes_to_copy = param->non_fixed_part_size;
-        int64_t min_chunksize = param->chunk_size_min;
-        int64_t max_chunksize = param->chunk_size_max;
-        int64_t size = 0;
-        int64_t available_bytes = 0;
-        int64_t read_bytes      = 0;
-        int64_t written_bytes   = 0;
-        char    buffer2[max_chunksize];
-
-        while (copied_non_fixed_bytes < non_fixed_bytes_to_copy) {
-            if (num_holes_gen < num_holes_non_fixed) {
-                if (num_holes_gen != num_holes_non_fixed-1)
-                    fseek(tar, non_fixed_hole_len, SEEK_CUR);
-                else
-                    fseek(tar, last_hole_size, SEEK_CUR);
-                num_holes_gen++;
-            }
-            size = random_chunk_size(min_chunksize, max_chunksize);
-            available_bytes = min(non_fixed_bytes_to_copy - copied_non_fixed_bytes, size);
-            read_bytes = fread(buffer2, 1, available_bytes, src);
-            if (read_bytes != available_bytes)
-                fprintf(stderr, "[WARN ]: should read %ld bytes, but only read %ld bytes\n", available_bytes, read_bytes);
-            written_bytes = fwrite(buffer2, 1, read_bytes, tar);
-            if (written_bytes != read_bytes)
-                fprintf(stderr, "[WARN ]: should write %ld bytes, but only wrote %ld bytes instead\n", read_bytes, written_bytes);
-            copied_non_fixed_bytes += written_bytes;
-        }
+    fprintf(stderr, "[ERROR]: failed to preallocate %ld bytes at offset %ld: %s\n", length, offset, strerror(errno));
+    return -1;
+}
+
+/* --sync and --drop-cache, once every descriptor of the file is closed */
+static int settle_file(param_t *param, stats_t *stats)
+{
+    uint64_t start = stats_now();
+
+    if (param->sync_mode != SYNC_MODE_NONE && sync_path(param->filename)) {
+        fprintf(stderr, "[ERROR]: failed to sync %s: %s\n", param->filename, strerror(errno));
+        return -1;
     }
-    else {
-        int64_t processed_bytes = 0;
-        int64_t bytes_to_write  = 0;
-        int64_t written_bytes   = 0;
-        int64_t read_bytes      = 0;
-        int64_t available_bytes = 0;
-        char    buffer[chunksize];
-
-        while (processed_bytes < bytes_to_write) {
-            available_bytes = min(chunksize, bytes_to_write-processed_bytes);
-            read_bytes = fread(buffer, 1, available_bytes, src);
-            if (available_bytes != read_bytes)
-                fprintf(stderr, "[WARN ]: should read %ld bytes, but read only %ld bytes\n", available_bytes, read_bytes);
-            written_bytes = fwrite(buffer, 1, read_bytes, tar);
-            if (read_bytes != written_bytes)
-                fprintf(stderr, "[WARN ]: should write %ld bytes, but wrote only %ld bytes instead\n", read_bytes, written_bytes);
-            processed_bytes += written_bytes;
-        }
+
+    uint64_t synced = stats_now();
+    stats_add_time(stats, 0, STATS_PHASE_SYNC, synced - start);
+
+    if (param->drop_cache && drop_cache_path(param->filename)) {
+        fprintf(stderr, "[ERROR]: failed to drop %s from the page cache: %s\n", param->filename, strerror(errno));
+        return -1;
     }
+    stats_add_time(stats, 0, STATS_PHASE_DROP_CACHE, stats_now() - synced);
 
     return 0;
 }
@@ -250,104 +409,1406 @@ static int do_generate_file_with_no_holes(param_t *param)
 {
     int error = 0;
 
+    chunk_pool_t *chunk_pool = chunk_pool_create(param->chunk_size_max, 1);
+    if (!chunk_pool) {
+        fprintf(stderr, "[ERROR]: failed to create chunk pool: %s\n", strerror(errno));
+        return -1;
+    }
+
     FILE *fp = fopen(param->filename, "wb+");
     if (!fp) {
         fprintf(stderr, "[ERROR]: generate_file: %s\n", strerror(errno));
+        chunk_pool_destroy(chunk_pool);
         return -1;
     }
 
+    stats_t *stats = start_stats(param, 1);
+
+    if (param->prealloc) {
+        uint64_t start = stats_now();
+        if (prealloc_data(param, fileno(fp), 0, param->filesize)) {
+            error = -1;
+            goto cleanup;
+        }
+        stats_add_time(stats, 0, STATS_PHASE_PREALLOC, stats_now() - start);
+    }
+
     /* populate the fixed part with random data */
-    if (populate_data_for_fixed_part(fp, param)) {
+    if (populate_data_for_fixed_part(fp, param, stats)) {
         fprintf(stderr, "[ERROR]: some errors occur when populate data for fixed part\n");
         error = -1;
         goto cleanup;
     }
 
     /* populate the non-fixed part with random data */
-    if (populate_data_for_non_fixed_part(fp, param)) {
+    if (populate_data_for_non_fixed_part(fp, param, chunk_pool, stats)) {
         fprintf(stderr, "[ERROR]: some errors occur when populate data for non fixed part\n");
         error = -1;
         goto cleanup;
     }
 
+    report_chunk_pools(param, &chunk_pool, 1);
+
 cleanup:
-    if (fp)
-        fclose(fp);
-    
-    return error;
+    if (fp) {
+        uint64_t start = stats_now();
+        if (fclose(fp))
+            error = -1;
+        stats_add_time(stats, 0, STATS_PHASE_SYNC, stats_now() - start);
+    }
+    if (!error && settle_file(param, stats))
+        error = -1;
+    chunk_pool_destroy(chunk_pool);
+
+    if (param->output)
+        param->output->size = error ? -1 : param->filesize;
+
+    return finish_stats(param, stats, error);
 }
 
-static int do_generate_file_with_holes(param_t *param)
+/*
+ * Decide where the holes go before anything is written: fixed holes follow
+ * randomly chosen fixed chunks, and non-fixed holes precede the first
+ * variable-size chunks. Data is then written straight to its final offset,
+ * and the holes are simply the ranges nobody writes.
+ *
+ * Holes are produced one at a time, in file order, by next_hole(): the
+ * fixed chunks are drawn with a sequential sampler, so millions of holes
+ * take neither memory nor a sort.
+ */
+static int plan_holes(param_t *param, const chunk_dict_t *dict, hole_plan_t *plan)
 {
-    int error = 0;
+    memset(plan, 0, sizeof(*plan));
 
-    FILE *fp = fopen(param->filename, "wb+");
-    if (!fp) {
-        fprintf(stderr, "[ERROR]: generate_file: %s\n", strerror(errno));
+    if (!param->enable_holes || param->num_holes <= 0)
+        return 0;
+
+    int64_t num_fixed_chunk      = param->fixed_part_size / param->chunk_size;
+    int64_t num_holes            = param->num_holes;
+    int64_t num_holes_fixed      = param->fixed_ratio * num_holes / 100;
+    int64_t num_holes_non_fixed  = num_holes - num_holes_fixed;
+    /* holes_size * num_holes_fixed overflows 64 bits with TBs of holes */
+    int64_t fixed_holes_size     = (__int128)param->holes_size * num_holes_fixed / num_holes;
+    int64_t non_fixed_holes_size = param->holes_size - fixed_holes_size;
+
+    if (num_holes_fixed > num_fixed_chunk) {
+        fprintf(stderr, "[ERROR]: %ld holes do not fit into %ld fixed chunks\n", num_holes_fixed, num_fixed_chunk);
         return -1;
     }
 
-    char temp_file[FILENAME_MAX];
-    char ext[] = "tmp";
-    if (strlen(param->filename) + strlen(ext) > FILENAME_MAX) {
-        fprintf(stderr, "[ERROR]: failed to generate temp file with name exceeed FILENAME_MAX limitation\n");
-        error = -1;
-        goto cleanup;
+    plan->param         = param;
+    plan->num_fixed     = num_holes_fixed;
+    plan->num_non_fixed = num_holes_non_fixed;
+    plan->payload       = param->fixed_part_size;
+    seqsample_init(&plan->fixed, gencont_derive(param->seed, GENCONT_STREAM_HOLES), num_holes_fixed, num_fixed_chunk);
+    plan->dict          = dict;
+    chunk_seq_init(&plan->chunks, param);
+
+    if (num_holes_fixed > 0) {
+        plan->fixed_hole_size      = fixed_holes_size / num_holes_fixed;
+        plan->fixed_last_hole_size = fixed_holes_size - plan->fixed_hole_size * (num_holes_fixed - 1);
     }
-    snprintf(temp_file, FILENAME_MAX, "%s.%s", param->filename, ext);
-    
-    FILE *temp_fp = fopen(temp_file, "wb+");
-    if (!temp_fp) {
-        fprintf(stderr, "[ERROR]: generate_file: %s\n", strerror(errno));
-        error = -1;
-        goto cleanup;
+    if (num_holes_non_fixed > 0) {
+        plan->non_fixed_hole_size      = non_fixed_holes_size / num_holes_non_fixed;
+        plan->non_fixed_last_hole_size = non_fixed_holes_size - plan->non_fixed_hole_size * (num_holes_non_fixed - 1);
     }
 
-    /* populate the fixed part with random data */
-    if (populate_data_for_fixed_part(temp_fp, param)) {
-        fprintf(stderr, "[ERROR]: some errors occur when populate data for fixed part\n");
-        error = -1;
-        goto cleanup;
+    return 0;
+}
+
+/* the next hole in file order, 0 once there are no more */
+static int next_hole(hole_plan_t *plan, hole_t *hole)
+{
+    param_t *param = plan->param;
+
+    if (!param)
+        return 0;
+
+    if (plan->fixed_done < plan->num_fixed) {
+        int64_t chunk_idx = seqsample_next(&plan->fixed);
+        hole->offset = (chunk_idx + 1) * param->chunk_size;
+        hole->length = ++plan->fixed_done < plan->num_fixed ? plan->fixed_hole_size : plan->fixed_last_hole_size;
+        return 1;
     }
 
-    /* populate the non-fixed part with random data */
-    if (populate_data_for_non_fixed_part(temp_fp, param)) {
-        fprintf(stderr, "[ERROR]: some errors occur when populate data for non fixed part\n");
-        error = -1;
-        goto cleanup;
+    if (plan->non_fixed_done < plan->num_non_fixed && plan->payload < param->filesize) {
+        hole->offset = plan->payload;
+        hole->length = ++plan->non_fixed_done < plan->num_non_fixed ?
+            plan->non_fixed_hole_size : plan->non_fixed_last_hole_size;
+        int64_t pick;
+        plan->payload += chunk_seq_next(&plan->chunks, param, plan->dict, &pick);
+        return 1;
     }
 
-    if (append_holes_from_temp_file_to_file(temp_fp, fp, param)) {
-        fprintf(stderr, "[ERROR]: failed to append holes from temp file to target file\n");
-        error = -1;
-        goto cleanup;
+    return 0;
+}
+
+/*
+ * --prealloc: allocate the data ranges of the file before they are written,
+ * leaving the holes out, so that the file system lays the extents out at
+ * once instead of as the workers get to them.
+ */
+static int prealloc_layout(genctx_t *ctx)
+{
+    param_t    *param       = ctx->param;
+    int64_t     payload     = 0;
+    int64_t     file_offset = 0;
+    hole_plan_t plan;
+    hole_t      hole;
+
+    if (!param->prealloc || ctx->sink->fd < 0)
+        return 0;
+
+    if (plan_holes(param, ctx->dict, &plan))
+        return -1;
+
+    while (param->prealloc && next_hole(&plan, &hole)) {
+        if (hole.offset > payload && prealloc_data(param, ctx->sink->fd, file_offset, hole.offset - payload))
+            return -1;
+        file_offset += hole.offset - payload + hole.length;
+        payload      = hole.offset;
     }
 
-cleanup:
-    if (fp)
-        fclose(fp);
-    if (temp_fp)
-        fclose(temp_fp);
+    if (param->prealloc && param->filesize > payload)
+        return prealloc_data(param, ctx->sink->fd, file_offset, param->filesize - payload);
 
-    if (remove(temp_file)) {
-        fprintf(stderr, "[ERROR]: failed to remove temp file: %s\n", strerror(errno));
-        error = -1;
+    return 0;
+}
+
+static int record_batch_flush(record_batch_t *batch)
+{
+    if (!batch->index || batch->count == 0)
+        return 0;
+
+    int ret = dedup_index_write(batch->index, batch->first, batch->records, batch->count);
+    batch->first += batch->count;
+    batch->count  = 0;
+
+    return ret;
+}
+
+static int record_batch_add(record_batch_t *batch, int64_t offset, int64_t length, int kind, uint64_t fp)
+{
+    dedup_record_t *record = &batch->records[batch->count++];
+
+    record->offset      = offset;
+    record->length      = length;
+    record->kind        = kind;
+    record->fingerprint = fp;
+
+    return batch->count == RECORD_BATCH ? record_batch_flush(batch) : 0;
+}
+
+/*
+ * Every fixed chunk is a copy of one of the patterns, and the only shorter
+ * one is the tail of the fixed part: all fingerprints are known in advance.
+ */
+static int index_fixed_range(genctx_t *ctx, genjob_t *job)
+{
+    int64_t        chunksize = ctx->param->chunk_size;
+    record_batch_t batch     = { .index = ctx->index, .first = job->first_record };
+
+    for (int64_t processed = 0 ; processed < job->length; processed += chunksize) {
+        int64_t  length  = min(job->length - processed, chunksize);
+        int64_t  pattern = fixed_pattern(ctx, (job->payload_offset + processed) / chunksize);
+        uint64_t fp      = ctx->fixed_tail_fingerprint;
+        if (length == chunksize) {
+            fp = ctx->pattern_fingerprints[pattern];
+            __atomic_fetch_or(&ctx->patterns_used[pattern / 64], 1ULL << (pattern % 64), __ATOMIC_RELAXED);
+        }
+        if (record_batch_add(&batch, job->file_offset + processed, length, DEDUP_KIND_FIXED, fp))
+            return -1;
     }
-    
-    return error;
+
+    return record_batch_flush(&batch);
 }
 
-int generate_file(param_t *param)
+/* hold a write of <length> bytes back to --rate, 1 once --duration is over */
+static inline int pace(genctx_t *ctx, int64_t length)
 {
-    if (!param) {
-        errno = EINVAL;
+    if (!ctx->rate || !rate_pace(ctx->rate, length))
+        return 0;
+
+    __atomic_store_n(&ctx->expired, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/* fixed payload [ payload, payload + length ), copied from the patterns or generated chunk by chunk */
+static void fill_fixed(genctx_t *ctx, char *buf, int64_t payload, int64_t length)
+{
+    int64_t chunksize = ctx->param->chunk_size;
+
+    for (int64_t pos = 0 ; pos < length; ) {
+        int64_t chunk_idx = (payload + pos) / chunksize;
+        int64_t skew      = (payload + pos) % chunksize;
+        int64_t available = min(length - pos, chunksize - skew);
+        int64_t pattern   = fixed_pattern(ctx, chunk_idx);
+
+        if (ctx->fixed_buffer)
+            memcpy(buf + pos, ctx->fixed_buffer + (ctx->patterns ? pattern * chunksize : 0) + skew, available);
+        else
+            gencont_fill(fixed_pattern_key(ctx, pattern), ctx->param->compress_ratio, skew, buf + pos, available);
+        pos += available;
+    }
+}
+
+static int populate_fixed_range(genctx_t *ctx, genjob_t *job, int worker)
+{
+    int64_t chunksize = ctx->param->chunk_size;
+    int64_t processed = 0;
+
+    sink_begin(ctx->sink, worker, job->kind);
+
+    while (processed < job->length) {
+        int64_t  skew   = (job->payload_offset + processed) % chunksize;
+        int64_t  offset = job->file_offset + processed;
+        int64_t  available;
+        uint64_t start  = stats_now();
+
+        if (ctx->fixed_buffer && !ctx->patterns) {
+            /* the fixed buffer is a whole number of chunks, so the rest of the range repeats it */
+            available = job->length - processed;
+            if (ctx->rate)
+                available = min(available, ctx->piece_size);
+            if (pace(ctx, available))
+                break;
+            start = stats_now();
+            if (sink_repeat(ctx->sink, worker, ctx->fixed_buffer, ctx->fixed_buffer_size, skew, offset, available))
+                return -1;
+        }
+        else {
+            /* the chunks differ, or are too large for the fixed buffer: assemble a piece at a time */
+            available = min(job->length - processed, ctx->piece_size);
+            if (pace(ctx, available))
+                break;
+            start = stats_now();
+            char *buf = sink_acquire(ctx->sink, worker, offset, available);
+            if (!buf)
+                return -1;
+            fill_fixed(ctx, buf, job->payload_offset + processed, available);
+            uint64_t generated = stats_now();
+            stats_add_time(ctx->stats, worker, STATS_PHASE_GENERATE, generated - start);
+            start = generated;
+            if (sink_commit(ctx->sink, worker, buf, offset, available))
+                return -1;
+        }
+
+        stats_add_write(ctx->stats, worker, stats_now() - start);
+        stats_add_data(ctx->stats, worker, available, 0);
+        processed += available;
+    }
+    stats_add_data(ctx->stats, worker, 0, job->num_chunks);
+
+    if (ctx->index)
+        return index_fixed_range(ctx, job);
+
+    return 0;
+}
+
+/*
+ * Generate payload [ payload, payload + length ) of a non-fixed range into
+ * <buf>, chunk by chunk: chunks drawn from the dictionary are copied out of
+ * its mapping and the others are generated. Finished chunks are
+ * fingerprinted into <batch>, at file offset payload + <file_delta>.
+ */
+static int fill_non_fixed(genctx_t *ctx, chunk_cursor_t *cur, char *buf, int64_t payload, int64_t length,
+    record_batch_t *batch, int64_t file_delta)
+{
+    /* nothing to follow chunk by chunk, the piece is generated at once */
+    if (!ctx->dict && !batch) {
+        gencont_fill(ctx->non_fixed_key, ctx->param->compress_ratio, payload, buf, length);
+        return 0;
+    }
+
+    for (int64_t pos = 0 ; pos < length; ) {
+        if (cur->left == 0) {
+            int64_t size = chunk_seq_next(&cur->chunks, ctx->param, ctx->dict, &cur->pick);
+            cur->offset = payload + pos;
+            cur->left   = min(size, cur->end - cur->offset);
+            if (batch)
+                fingerprint_begin(&cur->fp, cur->left);
+        }
+
+        int64_t available = min(cur->left, length - pos);
+        if (cur->pick >= 0)
+            memcpy(buf + pos, chunk_dict_get(ctx->dict, cur->pick) + (payload + pos - cur->offset), available);
+        else
+            gencont_fill(ctx->non_fixed_key, ctx->param->compress_ratio, payload + pos, buf + pos, available);
+        cur->left -= available;
+        pos       += available;
+
+        /* fingerprint the chunk while it is still hot in cache */
+        if (!batch)
+            continue;
+        fingerprint_update(&cur->fp, buf + pos - available, available);
+        if (cur->left == 0 && record_batch_add(batch, cur->offset + file_delta, payload + pos - cur->offset,
+                cur->pick >= 0 ? DEDUP_KIND_DICT : DEDUP_KIND_NON_FIXED, fingerprint_end(&cur->fp)))
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * A range holds whole variable-size chunks, so it can be far larger than a
+ * sink buffer: it is generated and written a piece at a time, and the chunk
+ * being generated is carried over from one piece to the next.
+ */
+static int populate_non_fixed_range(genctx_t *ctx, genjob_t *job, int worker)
+{
+    int64_t        processed = 0;
+    record_batch_t batch     = { .index = ctx->index, .first = job->first_record };
+    chunk_cursor_t cursor    = { .chunks = job->chunks, .end = job->payload_offset + job->length };
+
+    sink_begin(ctx->sink, worker, job->kind);
+
+    while (processed < job->length) {
+        int64_t offset = job->file_offset + processed;
+        int64_t length = min(job->length - processed, ctx->piece_size);
+
+        if (pace(ctx, length))
+            break;
+
+        /* the content is generated straight into the sink buffer */
+        char *buf = sink_acquire(ctx->sink, worker, offset, length);
+        if (!buf)
+            return -1;
+
+        uint64_t start = stats_now();
+        if (fill_non_fixed(ctx, &cursor, buf, job->payload_offset + processed, length,
+                ctx->index ? &batch : NULL, job->file_offset - job->payload_offset))
+            return -1;
+
+        uint64_t generated = stats_now();
+        stats_add_time(ctx->stats, worker, STATS_PHASE_GENERATE, generated - start);
+
+        if (sink_commit(ctx->sink, worker, buf, offset, length))
+            return -1;
+        stats_add_write(ctx->stats, worker, stats_now() - generated);
+        stats_add_data(ctx->stats, worker, length, 0);
+        processed += length;
+    }
+
+    if (record_batch_flush(&batch))
         return -1;
+    stats_add_data(ctx->stats, worker, 0, job->num_chunks);
+
+    return 0;
+}
+
+/* remember the lowest mismatching offset of every region */
+static void report_mismatch(genctx_t *ctx, int kind, int64_t offset, int64_t length)
+{
+    int64_t first = __atomic_load_n(&ctx->first_mismatch[kind], __ATOMIC_RELAXED);
+
+    while ((first < 0 || offset < first) &&
+           !__atomic_compare_exchange_n(&ctx->first_mismatch[kind], &first, offset, 0,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    __atomic_add_fetch(&ctx->mismatch_bytes[kind], length, __ATOMIC_RELAXED);
+}
+
+static void compare_range(genctx_t *ctx, int kind, const char *expected, const char *actual,
+    int64_t offset, int64_t length)
+{
+    if (memcmp(expected, actual, length) == 0)
+        return;
+
+    int64_t first = -1;
+    int64_t count = 0;
+    for (int64_t i = 0 ; i < length; i++) {
+        if (expected[i] != actual[i]) {
+            if (first < 0)
+                first = i;
+            count++;
+        }
     }
+    report_mismatch(ctx, kind, offset + first, count);
+}
 
-    if (param->enable_holes)
-        return do_generate_file_with_holes(param);
-    else
-        return do_generate_file_with_no_holes(param);
+/* read back up to <*length> bytes; whatever lies past the end of the file is a mismatch */
+static int read_range(genctx_t *ctx, int kind, char *buf, int64_t offset, int64_t *length)
+{
+    int64_t got = 0;
+
+    while (got < *length) {
+        ssize_t ret = pread(ctx->fd, buf + got, *length - got, offset + got);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (ret == 0)
+            break;
+        got += ret;
+    }
+
+    if (got < *length)
+        report_mismatch(ctx, kind, offset + got, *length - got);
+    *length = got;
 
     return 0;
+}
+
+static int verify_range(genctx_t *ctx, genjob_t *job, int worker)
+{
+    int64_t chunksize = ctx->param->chunk_size;
+    char   *expected  = ctx->buffers[2 * worker];
+    char   *actual    = ctx->buffers[2 * worker + 1];
+    int64_t processed = 0;
+    chunk_cursor_t cursor = { .chunks = job->chunks, .end = job->payload_offset + job->length };
+
+    while (processed < job->length) {
+        int64_t     payload = job->payload_offset + processed;
+        int64_t     offset  = job->file_offset + processed;
+        int64_t     length  = min(job->length - processed, ctx->piece_size);
+        const char *want    = expected;
+
+        /* the rest of the range is missing from a short file */
+        if (offset >= ctx->file_size) {
+            report_mismatch(ctx, job->kind, offset, job->length - processed);
+            break;
+        }
+
+        /* unallocated blocks of a hole read as zeros, TBs of them need not be read */
+        if (job->kind == RANGE_KIND_HOLE) {
+            int64_t data = lseek(ctx->fd, offset, SEEK_DATA);
+            if (data < 0)
+                data = errno == ENXIO ? ctx->file_size : offset;
+            data = min(data, min(ctx->file_size, job->file_offset + job->length));
+            if (data > offset) {
+                processed += data - offset;
+                continue;
+            }
+        }
+
+        if (job->kind == RANGE_KIND_FIXED && ctx->fixed_buffer && !ctx->patterns) {
+            /* every slice of the fixed part is a slice of the fixed buffer */
+            int64_t skew = payload % chunksize;
+            length = min(length, ctx->fixed_buffer_size - skew);
+            want   = ctx->fixed_buffer + skew;
+        }
+        else if (job->kind == RANGE_KIND_FIXED) {
+            fill_fixed(ctx, expected, payload, length);
+        }
+        else if (job->kind == RANGE_KIND_NON_FIXED) {
+            fill_non_fixed(ctx, &cursor, expected, payload, length, NULL, 0);
+        }
+        else {
+            memset(expected, 0, length);
+        }
+
+        int64_t got = length;
+        if (read_range(ctx, job->kind, actual, offset, &got))
+            return -1;
+        compare_range(ctx, job->kind, want, actual, offset, got);
+
+        processed += length;
+    }
+
+    return 0;
+}
+
+/*
+ * --checkpoint: record where the layout stands once the range <job> is
+ * written, before it is submitted. A slot is only reused once the range
+ * that held it is behind the durable point: while a long range is still
+ * being written, the submission waits for it instead of running ahead.
+ */
+static int track_submit(genctx_t *ctx, genjob_t *job)
+{
+    progress_t *progress = ctx->progress;
+
+    if (!progress)
+        return 0;
+
+    /* a worker must never see the new sequence number before its slot is reset */
+    pthread_mutex_lock(&progress->lock);
+    while (progress->submitted - progress->completed >= progress->num_slots) {
+        if (__atomic_load_n(&ctx->error, __ATOMIC_RELAXED)) {
+            pthread_mutex_unlock(&progress->lock);
+            return -1;
+        }
+        pthread_cond_wait(&progress->cond, &progress->lock);
+    }
+    job->seq = progress->submitted++;
+    progress_slot_t *slot = &progress->slots[job->seq % progress->num_slots];
+    slot->done = 0;
+    slot->pos  = ctx->pos;
+    pthread_mutex_unlock(&progress->lock);
+
+    return 0;
+}
+
+/*
+ * The range <job> is over: when <written>, move the durable position over
+ * every range done in a row. A failed range stays behind, and only wakes
+ * the submission up so that it sees the error.
+ */
+static void track_done(genctx_t *ctx, genjob_t *job, int written)
+{
+    progress_t *progress = ctx->progress;
+
+    if (!progress)
+        return;
+
+    pthread_mutex_lock(&progress->lock);
+    if (written)
+        progress->slots[job->seq % progress->num_slots].done = 1;
+    while (progress->completed < progress->submitted) {
+        progress_slot_t *slot = &progress->slots[progress->completed % progress->num_slots];
+        if (!slot->done)
+            break;
+        progress->durable = slot->pos;
+        progress->completed++;
+    }
+    pthread_cond_broadcast(&progress->cond);
+    pthread_mutex_unlock(&progress->lock);
+}
+
+/*
+ * Every --checkpoint bytes: sync what is written and record where the
+ * layout stands at the durable point, so that --resume starts from there.
+ * The position is taken before the sync, which covers it.
+ */
+static int take_checkpoint(genctx_t *ctx, int force)
+{
+    progress_t  *progress = ctx->progress;
+    layout_pos_t durable;
+
+    if (!progress)
+        return 0;
+
+    pthread_mutex_lock(&progress->lock);
+    durable = progress->durable;
+    pthread_mutex_unlock(&progress->lock);
+
+    if (durable.file_offset == progress->checkpointed || ctx->param->checkpoint_interval <= 0 ||
+        (!force && durable.file_offset - progress->checkpointed < ctx->param->checkpoint_interval))
+        return 0;
+
+    if (fdatasync(ctx->sink->fd)) {
+        fprintf(stderr, "[ERROR]: failed to sync %s for a checkpoint: %s\n", ctx->param->filename, strerror(errno));
+        return -1;
+    }
+    if (checkpoint_write(ctx->param->filename, ctx->param, durable.file_offset, &durable, sizeof(durable)))
+        return -1;
+    progress->checkpointed = durable.file_offset;
+
+    return 0;
+}
+
+static void populate_range(void *arg, int worker)
+{
+    genjob_t *job = arg;
+    genctx_t *ctx = job->ctx;
+    int       ret = 0;
+    int       written = 0;
+
+    if (!__atomic_load_n(&ctx->error, __ATOMIC_RELAXED) && !__atomic_load_n(&ctx->expired, __ATOMIC_RELAXED)) {
+        if (ctx->verify)
+            ret = verify_range(ctx, job, worker);
+        else if (job->kind == RANGE_KIND_FIXED)
+            ret = populate_fixed_range(ctx, job, worker);
+        else
+            ret = populate_non_fixed_range(ctx, job, worker);
+
+        if (ret) {
+            fprintf(stderr, "[ERROR]: failed to %s %ld bytes at offset %ld: %s\n",
+                ctx->verify ? "verify" : "write", job->length, job->file_offset, strerror(errno));
+            __atomic_store_n(&ctx->error, 1, __ATOMIC_RELAXED);
+        }
+        else
+            written = 1;
+    }
+    track_done(ctx, job, written);
+
+    free(job);
+}
+
+/*
+ * Skip the hole in front of the current position, recording it in the dedup
+ * index, and move on to the next one. In verify mode, the hole is checked for
+ * zeros like any other range.
+ */
+static int skip_hole(genctx_t *ctx, tpool_t *pool, int64_t *file_offset)
+{
+    hole_t *hole = &ctx->pos.hole;
+
+    if (ctx->verify) {
+        genjob_t *job = calloc(1, sizeof(genjob_t));
+        if (!job)
+            return -1;
+        job->ctx         = ctx;
+        job->kind        = RANGE_KIND_HOLE;
+        job->file_offset = *file_offset;
+        job->length      = hole->length;
+        if (tpool_submit(pool, populate_range, job)) {
+            free(job);
+            return -1;
+        }
+    }
+
+    if (ctx->sink && sink_hole(ctx->sink, *file_offset, hole->length))
+        return -1;
+
+    if (ctx->index) {
+        dedup_record_t record = {
+            .offset = *file_offset,
+            .length = hole->length,
+            .kind   = DEDUP_KIND_HOLE,
+        };
+        if (dedup_index_write(ctx->index, ctx->num_records++, &record, 1))
+            return -1;
+    }
+
+    ctx->summary.num_holes++;
+    ctx->summary.hole_bytes += hole->length;
+    *file_offset += hole->length;
+
+    ctx->pos.has_hole = next_hole(&ctx->pos.holes, &ctx->pos.hole);
+
+    return 0;
+}
+
+/* a dictionary chunk copied into the file again adds nothing unique, for the index */
+static inline void count_dict_chunk(genctx_t *ctx, int64_t pick, int64_t size)
+{
+    if (!ctx->dict_used)
+        return;
+
+    uint64_t bit = 1ULL << (pick % 64);
+    if (ctx->dict_used[pick / 64] & bit)
+        ctx->repeated_bytes += size;
+    ctx->dict_used[pick / 64] |= bit;
+}
+
+/* put the walk of the layout at the start of the file */
+static int start_layout(genctx_t *ctx)
+{
+    layout_pos_t *pos = &ctx->pos;
+
+    memset(pos, 0, sizeof(*pos));
+    if (plan_holes(ctx->param, ctx->dict, &pos->holes))
+        return -1;
+    chunk_seq_init(&pos->chunks, ctx->param);
+    pos->has_hole = next_hole(&pos->holes, &pos->hole);
+
+    return 0;
+}
+
+/*
+ * Walk the payload [ 0, filesize ) once, from where ctx->pos stands, cut it
+ * into disjoint ranges that never straddle a hole or the fixed/non-fixed
+ * boundary, and submit them to the pool. Returns the final size of the
+ * target file, holes included, or the offset reached when --duration ran
+ * out.
+ */
+static int64_t submit_ranges(genctx_t *ctx, tpool_t *pool)
+{
+    param_t      *param      = ctx->param;
+    layout_pos_t *pos        = &ctx->pos;
+    int64_t       fixed_unit = (GENFILE_UNIT_SIZE / param->chunk_size + 1) * param->chunk_size;
+
+    /* few but large fixed ranges when they cost a syscall per batch, still enough for every worker */
+    if (ctx->sink && ctx->sink->ops->repeat && ctx->fixed_buffer && !ctx->patterns && !ctx->rate &&
+        !ctx->sink->writeback) {
+        int64_t batch = min(GENFILE_FIXED_BATCH_SIZE, param->fixed_part_size / (4 * param->threads));
+        if (ctx->progress)
+            batch = min(batch, param->checkpoint_interval);
+        batch = batch / param->chunk_size * param->chunk_size;
+        if (batch > fixed_unit)
+            fixed_unit = batch;
+    }
+
+    struct {
+        int     kind;
+        int64_t end;
+        int64_t unit;
+    } regions[] = {
+        { RANGE_KIND_FIXED,     param->fixed_part_size, fixed_unit        },
+        { RANGE_KIND_NON_FIXED, param->filesize,        GENFILE_UNIT_SIZE },
+    };
+
+    for (int r = 0 ; r < sizeof(regions)/sizeof(regions[0]); r++) {
+        while (pos->payload < regions[r].end) {
+            if (__atomic_load_n(&ctx->expired, __ATOMIC_RELAXED) || rate_expired(ctx->rate))
+                return pos->file_offset;
+
+            while (pos->has_hole && pos->hole.offset <= pos->payload) {
+                if (skip_hole(ctx, pool, &pos->file_offset))
+                    return -1;
+            }
+
+            int64_t next = regions[r].end;
+            if (pos->has_hole && pos->hole.offset < next)
+                next = pos->hole.offset;
+
+            genjob_t *job = calloc(1, sizeof(genjob_t));
+            if (!job)
+                return -1;
+            job->ctx            = ctx;
+            job->kind           = regions[r].kind;
+            job->payload_offset = pos->payload;
+            job->file_offset    = pos->file_offset;
+            job->chunks         = pos->chunks;
+            job->first_record   = ctx->num_records;
+
+            int64_t num_chunks = 0;
+            if (regions[r].kind == RANGE_KIND_FIXED) {
+                job->length = min(next - pos->payload, regions[r].unit);
+                num_chunks  = (job->length + param->chunk_size - 1) / param->chunk_size;
+            }
+            else {
+                /* whole variable-size chunks, so that holes keep falling on chunk boundaries */
+                int64_t length = 0;
+                while (length < regions[r].unit && pos->payload + length < next) {
+                    int64_t pick;
+                    int64_t size = chunk_seq_next(&pos->chunks, param, ctx->dict, &pick);
+                    if (pick >= 0 && pos->payload + length + size <= next)
+                        count_dict_chunk(ctx, pick, size);
+                    length += size;
+                    num_chunks++;
+                }
+                job->length = min(length, next - pos->payload);
+            }
+            job->num_chunks          = num_chunks;
+            ctx->num_records        += num_chunks;
+            ctx->summary.num_chunks += num_chunks;
+            ctx->summary.data_bytes += job->length;
+
+            pos->payload     += job->length;
+            pos->file_offset += job->length;
+
+            if (track_submit(ctx, job) || tpool_submit(pool, populate_range, job)) {
+                free(job);
+                return -1;
+            }
+            if (take_checkpoint(ctx, 0))
+                return -1;
+        }
+    }
+
+    while (pos->has_hole) {
+        if (skip_hole(ctx, pool, &pos->file_offset))
+            return -1;
+    }
+
+    return pos->file_offset;
+}
+
+/*
+ * Ground truth: the non-fixed part only repeats dictionary chunks, and the
+ * fixed part holds the full-size patterns it used plus, maybe, a shorter
+ * tail of one of them.
+ */
+static int finish_dedup_index(genctx_t *ctx)
+{
+    param_t         *param   = ctx->param;
+    dedup_summary_t *summary = &ctx->summary;
+
+    summary->unique_bytes = param->non_fixed_part_size - ctx->repeated_bytes;
+    for (int64_t i = 0 ; i < (ctx->num_patterns + 63) / 64; i++)
+        summary->unique_bytes += __builtin_popcountll(ctx->patterns_used[i]) * param->chunk_size;
+    summary->unique_bytes += param->fixed_part_size % param->chunk_size;
+
+    if (!param->quiet) {
+        fprintf(stdout, "[INFO ]: dedup index %s: %ld chunks, %ld unique bytes, expected dedup ratio %.4f\n",
+            param->index_path, summary->num_chunks, summary->unique_bytes,
+            summary->unique_bytes > 0 ? (double)summary->data_bytes / summary->unique_bytes : 1.0);
+    }
+
+    return dedup_index_finish(ctx->index, ctx->num_records, summary);
+}
+
+static inline int64_t mem_limit(param_t *param)
+{
+    return param->mem_limit > 0 ? param->mem_limit : PARAM_DEFAULT_MEM_LIMIT;
+}
+
+/*
+ * Popularity of the fixed patterns: uniform, Zipf (pattern k weighs
+ * 1 / (k + 1)^skew) or hot/cold (hot_ratio percent of the patterns take
+ * hot_traffic percent of the chunks).
+ */
+static int create_patterns(genctx_t *ctx)
+{
+    param_t *param = ctx->param;
+    int64_t  n     = param->fixed_patterns > 1 ? param->fixed_patterns : 1;
+
+    ctx->num_patterns = n;
+    ctx->pattern_key  = gencont_derive(param->seed, GENCONT_STREAM_PATTERNS);
+    if (n == 1)
+        return 0;
+
+    double *weights = malloc(n * sizeof(double));
+    if (!weights)
+        return -1;
+
+    int64_t num_hot = (n * param->hot_ratio + 99) / 100;
+    for (int64_t k = 0 ; k < n; k++) {
+        switch (param->pattern_dist) {
+        case PATTERN_DIST_ZIPF:
+            weights[k] = 1.0 / pow(k + 1, param->pattern_skew);
+            break;
+        case PATTERN_DIST_HOTCOLD:
+            if (num_hot >= n)
+                weights[k] = 1.0;
+            else if (k < num_hot)
+                weights[k] = param->hot_traffic / (double)num_hot;
+            else
+                weights[k] = (100 - param->hot_traffic) / (double)(n - num_hot);
+            break;
+        default:
+            weights[k] = 1.0;
+            break;
+        }
+    }
+
+    ctx->patterns = alias_create(weights, n);
+    free(weights);
+    if (!ctx->patterns) {
+        fprintf(stderr, "[ERROR]: failed to build the fixed pattern table: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * The patterns, one after the other, kept resident (on huge pages when the
+ * kernel has them) so that reusing one is a memcpy. When they take more
+ * than half of --mem-limit, they are generated again for every chunk.
+ */
+static int create_pattern_pool(genctx_t *ctx)
+{
+    param_t *param = ctx->param;
+    int64_t  size  = ctx->num_patterns * param->chunk_size;
+    void    *pool  = NULL;
+
+    if (param->fixed_part_size <= 0 || size > mem_limit(param) / 2)
+        return 0;
+
+    if (posix_memalign(&pool, GENFILE_HUGEPAGE_SIZE, size)) {
+        fprintf(stderr, "[ERROR]: failed to create the fixed pattern pool\n");
+        return -1;
+    }
+    madvise(pool, size, MADV_HUGEPAGE);
+
+    ctx->fixed_buffer      = pool;
+    ctx->fixed_buffer_size = size;
+    for (int64_t k = 0 ; k < ctx->num_patterns; k++)
+        gencont_fill(fixed_pattern_key(ctx, k), param->compress_ratio, 0, ctx->fixed_buffer + k * param->chunk_size, param->chunk_size);
+
+    return 0;
+}
+
+/*
+ * One shared, read-only buffer holding the fixed chunk repeated over a unit.
+ * Chunks larger than a unit, or a buffer taking more than half of
+ * --mem-limit, are generated a piece at a time instead.
+ */
+static int create_fixed_buffer(genctx_t *ctx)
+{
+    param_t *param = ctx->param;
+    int64_t  size  = (GENFILE_UNIT_SIZE / param->chunk_size + 2) * param->chunk_size;
+
+    if (create_patterns(ctx))
+        return -1;
+
+    if (ctx->patterns)
+        return create_pattern_pool(ctx);
+
+    if (param->fixed_part_size <= 0 || param->chunk_size > GENFILE_UNIT_SIZE || size > mem_limit(param) / 2)
+        return 0;
+
+    ctx->fixed_buffer_size = size;
+    ctx->fixed_buffer      = malloc(ctx->fixed_buffer_size);
+    if (!ctx->fixed_buffer) {
+        fprintf(stderr, "[ERROR]: failed to create fixed chunk\n");
+        return -1;
+    }
+
+    gencont_fill(ctx->fixed_key, param->compress_ratio, 0, ctx->fixed_buffer, param->chunk_size);
+    for (int64_t off = param->chunk_size ; off < ctx->fixed_buffer_size; off += param->chunk_size)
+        memcpy(ctx->fixed_buffer + off, ctx->fixed_buffer, param->chunk_size);
+
+    return 0;
+}
+
+/*
+ * Ranges are generated in pieces of up to a unit, one per buffer. When
+ * <num_buffers> of them and the fixed buffer do not fit under --mem-limit,
+ * the pieces shrink, so memory depends on the threads and the queue depth
+ * but never on the file size or the chunk sizes.
+ */
+static int plan_piece_size(genctx_t *ctx, int num_buffers)
+{
+    int64_t budget = mem_limit(ctx->param) - ctx->fixed_buffer_size;
+    int64_t piece  = GENFILE_UNIT_SIZE;
+
+    while (piece > GENFILE_MIN_PIECE_SIZE && num_buffers * (piece + GENFILE_BUFFER_SLACK) > budget)
+        piece /= 2;
+
+    /* a piece is paced as a whole, so with --rate it is no larger than the bucket */
+    while (ctx->param->rate && piece > GENFILE_MIN_PIECE_SIZE && piece > ctx->param->rate * RATE_BURST_MS / 1000)
+        piece /= 2;
+
+    if (num_buffers * (piece + GENFILE_BUFFER_SLACK) > budget) {
+        fprintf(stderr, "[ERROR]: %d buffers of %lld bytes do not fit under the memory limit of %ld bytes\n",
+            num_buffers, GENFILE_MIN_PIECE_SIZE, mem_limit(ctx->param));
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ctx->piece_size = piece;
+
+    return 0;
+}
+
+/* fingerprint of the first <length> bytes of fixed pattern <pattern> */
+static int fixed_fingerprint(genctx_t *ctx, int64_t pattern, int64_t length, uint64_t *fp)
+{
+    if (ctx->fixed_buffer) {
+        *fp = fingerprint(ctx->fixed_buffer + (ctx->patterns ? pattern * ctx->param->chunk_size : 0), length);
+        return 0;
+    }
+
+    char *piece = malloc(ctx->piece_size);
+    if (!piece)
+        return -1;
+
+    fingerprint_t state;
+    fingerprint_begin(&state, length);
+    for (int64_t offset = 0 ; offset < length; offset += ctx->piece_size) {
+        int64_t available = min(length - offset, ctx->piece_size);
+        gencont_fill(fixed_pattern_key(ctx, pattern), ctx->param->compress_ratio, offset, piece, available);
+        fingerprint_update(&state, piece, available);
+    }
+    *fp = fingerprint_end(&state);
+    free(piece);
+
+    return 0;
+}
+
+static int fingerprint_patterns(genctx_t *ctx)
+{
+    param_t *param = ctx->param;
+
+    ctx->pattern_fingerprints = calloc(ctx->num_patterns, sizeof(uint64_t));
+    ctx->patterns_used        = calloc((ctx->num_patterns + 63) / 64, sizeof(uint64_t));
+    if (!ctx->pattern_fingerprints || !ctx->patterns_used)
+        return -1;
+
+    if (param->fixed_part_size <= 0)
+        return 0;
+
+    for (int64_t k = 0 ; k < ctx->num_patterns; k++) {
+        if (fixed_fingerprint(ctx, k, param->chunk_size, &ctx->pattern_fingerprints[k]))
+            return -1;
+    }
+
+    int64_t tail = fixed_pattern(ctx, param->fixed_part_size / param->chunk_size);
+    return fixed_fingerprint(ctx, tail, param->fixed_part_size % param->chunk_size, &ctx->fixed_tail_fingerprint);
+}
+
+/*
+ * --checkpoint and --resume: follow the ranges in flight and, to resume,
+ * take the position of the layout back from the checkpoint of the file.
+ */
+static int create_progress(genctx_t *ctx)
+{
+    param_t *param = ctx->param;
+
+    if (param->checkpoint_interval <= 0 && !param->resume)
+        return 0;
+
+    progress_t *progress = calloc(1, sizeof(progress_t));
+    if (!progress)
+        return -1;
+    pthread_mutex_init(&progress->lock, NULL);
+    pthread_cond_init(&progress->cond, NULL);
+    ctx->progress = progress;
+
+    /* more than the pool holds, so that the submission only waits behind a long range */
+    progress->num_slots = 4 * param->threads + 4;
+    progress->slots     = calloc(progress->num_slots, sizeof(progress_slot_t));
+    if (!progress->slots)
+        return -1;
+
+    if (!param->resume)
+        return 0;
+
+    param_t     saved;
+    int64_t     durable;
+    struct stat st;
+
+    if (checkpoint_read(param->filename, &saved, &durable, &ctx->pos, sizeof(ctx->pos)))
+        return -1;
+
+    const char *option = checkpoint_differs(param, &saved);
+    if (option) {
+        fprintf(stderr, "[ERROR]: the %s setting of %s differs from that of its checkpoint\n", option, param->filename);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ctx->pos.file_offset != durable) {
+        fprintf(stderr, "[ERROR]: the checkpoint of %s is inconsistent\n", param->filename);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (stat(param->filename, &st) || st.st_size < durable) {
+        fprintf(stderr, "[ERROR]: %s is shorter than the %ld bytes its checkpoint has on disk\n",
+            param->filename, durable);
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* the pointers of the saved position were those of the interrupted run */
+    if (ctx->pos.holes.param)
+        ctx->pos.holes.param = param;
+    ctx->pos.holes.dict = ctx->dict;
+
+    progress->durable      = ctx->pos;
+    progress->checkpointed = durable;
+
+    if (!param->quiet)
+        fprintf(stdout, "[INFO ]: resuming %s at offset %ld\n", param->filename, durable);
+
+    return 0;
+}
+
+static void destroy_progress(progress_t *progress)
+{
+    if (!progress)
+        return;
+
+    pthread_mutex_destroy(&progress->lock);
+    pthread_cond_destroy(&progress->cond);
+    free(progress->slots);
+    free(progress);
+}
+
+static int do_generate_file_in_ranges(param_t *param)
+{
+    int      error = 0;
+    genctx_t ctx   = {
+        .param         = param,
+        .fixed_key     = gencont_derive(param->seed, GENCONT_STREAM_FIXED),
+        .non_fixed_key = gencont_derive(param->seed, GENCONT_STREAM_NON_FIXED),
+    };
+    tpool_t *pool  = NULL;
+    int64_t  total_size = -1;
+
+    if (param->dict_path) {
+        ctx.dict = chunk_dict_open(param, 1);
+        if (!ctx.dict)
+            return -1;
+    }
+
+    if (start_layout(&ctx)) {
+        fprintf(stderr, "[ERROR]: failed to plan the holes\n");
+        error = -1;
+        goto cleanup;
+    }
+
+    if (create_progress(&ctx)) {
+        error = -1;
+        goto cleanup;
+    }
+
+    if (create_fixed_buffer(&ctx)) {
+        error = -1;
+        goto cleanup;
+    }
+
+    int sink_type = SINK_TYPE_PWRITE;
+    if (param->output && param->output->type >= 0)
+        sink_type = param->output->type;
+    else if (param_is_stream(param))
+        sink_type = SINK_TYPE_STREAM;
+    else if (param->mmap)
+        sink_type = SINK_TYPE_MMAP;
+    else if (param->async)
+        sink_type = SINK_TYPE_ASYNC;
+    else if (param->direct)
+        sink_type = SINK_TYPE_DIRECT;
+
+    if (plan_piece_size(&ctx, sink_num_buffers(sink_type, param, param->threads))) {
+        error = -1;
+        goto cleanup;
+    }
+
+    if (param->index_path) {
+        ctx.index = dedup_index_create(param->index_path, param);
+        if (!ctx.index) {
+            error = -1;
+            goto cleanup;
+        }
+        if (fingerprint_patterns(&ctx)) {
+            error = -1;
+            goto cleanup;
+        }
+        if (ctx.dict) {
+            ctx.dict_used = calloc((ctx.dict->num_chunks + 63) / 64, sizeof(uint64_t));
+            if (!ctx.dict_used) {
+                error = -1;
+                goto cleanup;
+            }
+        }
+    }
+
+    ctx.sink = sink_create(sink_type, param, param->threads, ctx.piece_size);
+    if (!ctx.sink) {
+        error = -1;
+        goto cleanup;
+    }
+
+    pool = tpool_create(param->threads, 2 * param->threads);
+    if (!pool) {
+        fprintf(stderr, "[ERROR]: failed to create worker pool: %s\n", strerror(errno));
+        error = -1;
+        goto cleanup;
+    }
+
+    ctx.stats = start_stats(param, param->threads);
+
+    {
+        uint64_t start = stats_now();
+        if (prealloc_layout(&ctx)) {
+            error = -1;
+            goto cleanup;
+        }
+        stats_add_time(ctx.stats, 0, STATS_PHASE_PREALLOC, stats_now() - start);
+    }
+
+    if (param->rate || param->duration > 0) {
+        ctx.rate = rate_create(param);
+        if (!ctx.rate) {
+            error = -1;
+            goto cleanup;
+        }
+    }
+    stats_set_rate(ctx.stats, ctx.rate);
+
+    /* --loop and --duration write the same file over and over */
+    int64_t passes = 0;
+    for (int64_t pass = 0 ; ; pass++) {
+        int64_t size = submit_ranges(&ctx, pool);
+        tpool_wait(pool);
+
+        if (size < 0 || ctx.error) {
+            fprintf(stderr, "[ERROR]: some errors occur when populating data\n");
+            error = -1;
+            total_size = -1;
+            break;
+        }
+
+        /* a pass cut short leaves the size of a whole one behind it, if any */
+        total_size = max(total_size, size);
+        passes     = pass + 1;
+        if (ctx.expired || rate_expired(ctx.rate))
+            break;
+        if (param->loops ? pass + 1 >= param->loops : param->duration <= 0)
+            break;
+
+        if (start_layout(&ctx)) {
+            error = -1;
+            total_size = -1;
+            break;
+        }
+    }
+
+    if (!error && !param->quiet && (param->loops > 1 || param->duration > 0))
+        fprintf(stdout, "[INFO ]: %ld passes over the file%s\n", passes,
+            ctx.expired || rate_expired(ctx.rate) ? ", the last one cut short by --duration" : "");
+
+    if (ctx.index && total_size >= 0 && finish_dedup_index(&ctx)) {
+        fprintf(stderr, "[ERROR]: failed to write the dedup index summary\n");
+        error = -1;
+    }
+
+    if (param->output)
+        param->output->size = total_size;
+
+cleanup:
+    /* drain the sink while the workers that queued its writes are still alive */
+    {
+        uint64_t start = stats_now();
+        if (sink_destroy(ctx.sink, total_size))
+            error = -1;
+        stats_add_time(ctx.stats, 0, STATS_PHASE_SYNC, stats_now() - start);
+    }
+    if (!error && ctx.sink && settle_file(param, ctx.stats))
+        error = -1;
+    /* a finished file needs no checkpoint, an unfinished one keeps its last */
+    if (!error && ctx.progress && checkpoint_remove(param->filename))
+        error = -1;
+    tpool_destroy(pool);
+    if (ctx.stats)
+        error = finish_stats(param, ctx.stats, error);
+    rate_destroy(ctx.rate);
+    destroy_progress(ctx.progress);
+    free(ctx.fixed_buffer);
+    alias_destroy(ctx.patterns);
+    free(ctx.pattern_fingerprints);
+    free(ctx.patterns_used);
+    free(ctx.dict_used);
+    dedup_index_destroy(ctx.index);
+    chunk_dict_close(ctx.dict);
+
+    return error;
+}
+
+int generate_file(param_t *param)
+{
+    if (!param) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* the stdio path holds whole chunks in memory, knows a single fixed chunk and no dictionary, and writes a file */
+    if (param->threads > 1 || param->enable_holes || param->direct || param->async || param->index_path ||
+        param->mmap || param_is_stream(param) ||
+        param->chunk_size > GENFILE_UNIT_SIZE || param->chunk_size_max > GENFILE_UNIT_SIZE || param->dict_path ||
+        param->fixed_patterns > 1 || (param->output && param->output->type >= 0) ||
+        param->rate || param->duration > 0 || param->loops > 1 || param->sync_mode == SYNC_MODE_EVERY ||
+        param->checkpoint_interval > 0 || param->resume)
+        return do_generate_file_in_ranges(param);
+    else
+        return do_generate_file_with_no_holes(param);
+
+    return 0;
+}
+
+/*
+ * Rebuild the expected content of <param->filename> from the seed and the
+ * settings it was generated with, and compare the file against it in
+ * parallel. The layout, holes included, is cut into the same ranges as when
+ * writing, so no reference copy is needed.
+ */
+int verify_file(param_t *param)
+{
+    int      error = 0;
+    genctx_t ctx   = {
+        .param         = param,
+        .fixed_key     = gencont_derive(param->seed, GENCONT_STREAM_FIXED),
+        .non_fixed_key = gencont_derive(param->seed, GENCONT_STREAM_NON_FIXED),
+        .verify        = 1,
+        .fd            = -1,
+    };
+    tpool_t *pool        = NULL;
+    int64_t  total_size  = -1;
+    struct timespec start, end;
+
+    if (!param) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (int k = 0 ; k < RANGE_KIND_LAST; k++)
+        ctx.first_mismatch[k] = -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* the file was generated from the dictionary as it is now */
+    if (param->dict_path) {
+        ctx.dict = chunk_dict_open(param, 0);
+        if (!ctx.dict)
+            return -1;
+    }
+
+    if (start_layout(&ctx)) {
+        fprintf(stderr, "[ERROR]: failed to plan the holes\n");
+        error = -1;
+        goto cleanup;
+    }
+
+    if (create_fixed_buffer(&ctx) || plan_piece_size(&ctx, 2 * param->threads)) {
+        error = -1;
+        goto cleanup;
+    }
+
+    ctx.fd = open(param->filename, O_RDONLY);
+    if (ctx.fd < 0) {
+        fprintf(stderr, "[ERROR]: failed to open %s: %s\n", param->filename, strerror(errno));
+        error = -1;
+        goto cleanup;
+    }
+
+    struct stat st;
+    if (fstat(ctx.fd, &st)) {
+        error = -1;
+        goto cleanup;
+    }
+    ctx.file_size = st.st_size;
+    posix_fadvise(ctx.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    ctx.buffers = calloc(2 * param->threads, sizeof(char *));
+    if (!ctx.buffers) {
+        error = -1;
+        goto cleanup;
+    }
+    for (int i = 0 ; i < 2 * param->threads; i++) {
+        ctx.buffers[i] = alloc_aligned(ctx.piece_size, FUTIL_DIRECT_ALIGNMENT);
+        if (!ctx.buffers[i]) {
+            error = -1;
+            goto cleanup;
+        }
+    }
+
+    pool = tpool_create(param->threads, 2 * param->threads);
+    if (!pool) {
+        fprintf(stderr, "[ERROR]: failed to create worker pool: %s\n", strerror(errno));
+        error = -1;
+        goto cleanup;
+    }
+
+    total_size = submit_ranges(&ctx, pool);
+    tpool_wait(pool);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (total_size < 0 || ctx.error) {
+        fprintf(stderr, "[ERROR]: some errors occur when verifying %s\n", param->filename);
+        error = -1;
+        goto cleanup;
+    }
+
+    if (ctx.file_size != total_size) {
+        fprintf(stderr, "[ERROR]: %s: size is %ld bytes, expected %ld bytes\n",
+            param->filename, ctx.file_size, total_size);
+        error = -1;
+    }
+
+    for (int k = 0 ; k < RANGE_KIND_LAST; k++) {
+        if (ctx.first_mismatch[k] >= 0) {
+            fprintf(stderr, "[ERROR]: %s: %s region: %ld bytes differ, first mismatch at offset %ld\n",
+                param->filename, range_kind_names[k], ctx.mismatch_bytes[k], ctx.first_mismatch[k]);
+            error = -1;
+        }
+    }
+
+    if (!param->quiet) {
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stdout, "[INFO ]: %s: %ld bytes checked in %.2f s (%.2f MB/s), %s\n",
+            param->filename, total_size, elapsed, elapsed > 0 ? total_size / 1048576.0 / elapsed : 0.0,
+            error ? "MISMATCH" : "OK");
+    }
+
+cleanup:
+    tpool_destroy(pool);
+    if (ctx.buffers) {
+        for (int i = 0 ; i < 2 * param->threads; i++)
+            free(ctx.buffers[i]);
+        free(ctx.buffers);
+    }
+    if (ctx.fd >= 0)
+        close(ctx.fd);
+    free(ctx.fixed_buffer);
+    alias_destroy(ctx.patterns);
+    chunk_dict_close(ctx.dict);
+
+    return error;
 }
\ No newline at end of file
@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "gentree.h"
+#include "futil.h"
+#include "gencont.h"
+#include "stats.h"
+#include "tpool.h"
+
+#define min(a,b) (((a)>(b))?(b):(a))
+
+/* deepest tree, reached with a fanout of 2 and 2^64 leaves */
+#define GENTREE_MAX_DEPTH 64
+/* longest relative path of a leaf directory, "d<n>/" per level */
+#define GENTREE_PATH_MAX  (GENTREE_MAX_DEPTH * 24)
+
+/* progress is reported every second, unless quiet */
+#define GENTREE_REPORT_INTERVAL_MS 1000
+
+/*
+ * Layout: the files are cut into leaves of --dir-files files, and the
+ * leaves are the bottom level of a tree of --fanout directories per level,
+ * as deep as it takes to hold them all. Leaf <j> is the directory whose
+ * path spells <j> in base fanout, and holds files [ j * dir_files,
+ * (j + 1) * dir_files ).
+ *
+ * The directories are created by the submitting thread, in order, right
+ * before the leaf is handed to a worker. A worker opens the leaf once and
+ * creates all of its files with openat() relative to it, generating every
+ * file into the one buffer it owns.
+ */
+
+typedef struct treectx_t {
+    param_t  *param;
+    int       root_fd;
+    int       depth;
+    int64_t   num_leaves;
+    char    **buffers;      /* one per worker, as large as the largest file */
+    stats_t  *stats;
+    int       error;
+    int64_t   num_dirs;
+} treectx_t;
+
+typedef struct treejob_t {
+    treectx_t *ctx;
+    int64_t    leaf;
+    char       path[GENTREE_PATH_MAX];
+} treejob_t;
+
+int64_t tree_file_size(const param_t *param, int64_t index)
+{
+    uint64_t key = gencont_derive(param->seed, GENCONT_STREAM_TREE_SIZES);
+    double   u   = (gencont_hash64(key, index) >> 11) * 0x1.0p-53;
+
+    /* log-uniform: as many files of 4-8 KB as of 512 KB-1 MB */
+    double size = exp(log(param->file_size_min) + u * (log(param->file_size_max) - log(param->file_size_min)));
+
+    return min((int64_t)size, param->file_size_max);
+}
+
+uint64_t tree_file_seed(const param_t *param, int64_t index)
+{
+    return gencont_derive(gencont_derive(param->seed, GENCONT_STREAM_TREE_FILES), index);
+}
+
+/* the same bytes as a single file of <size> generated with <seed> */
+static void fill_tree_file(const param_t *param, uint64_t seed, char *buf, int64_t size)
+{
+    int64_t fixed = size * param->fixed_ratio / 100;
+    int64_t chunk = min(param->chunk_size, fixed);
+
+    gencont_fill(gencont_derive(seed, GENCONT_STREAM_FIXED), param->compress_ratio, 0, buf, chunk);
+    for (int64_t pos = chunk ; pos < fixed; pos += chunk)
+        memcpy(buf + pos, buf, min(chunk, fixed - pos));
+
+    gencont_fill(gencont_derive(seed, GENCONT_STREAM_NON_FIXED), param->compress_ratio, fixed, buf + fixed, size - fixed);
+}
+
+static int write_tree_file(treectx_t *ctx, int dir_fd, int64_t index, int worker)
+{
+    param_t *param = ctx->param;
+    char    *buf   = ctx->buffers[worker];
+    int64_t  size  = tree_file_size(param, index);
+    char     name[32];
+
+    uint64_t start = stats_now();
+    fill_tree_file(param, tree_file_seed(param, index), buf, size);
+    uint64_t generated = stats_now();
+    stats_add_time(ctx->stats, worker, STATS_PHASE_GENERATE, generated - start);
+
+    snprintf(name, sizeof(name), "f%ld", index);
+    int fd = openat(dir_fd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0)
+        return -1;
+
+    int error = pwrite_full(fd, buf, size, 0);
+    if (close(fd))
+        error = -1;
+    stats_add_write(ctx->stats, worker, stats_now() - generated);
+
+    if (!error)
+        stats_add_data(ctx->stats, worker, size, 1);
+
+    return error;
+}
+
+static void populate_leaf(void *arg, int worker)
+{
+    treejob_t *job   = arg;
+    treectx_t *ctx   = job->ctx;
+    param_t   *param = ctx->param;
+    int64_t    first = job->leaf * param->tree_dir_files;
+    int64_t    last  = min(first + param->tree_dir_files, param->tree_files);
+
+    if (__atomic_load_n(&ctx->error, __ATOMIC_RELAXED))
+        goto out;
+
+    int dir_fd = openat(ctx->root_fd, job->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        fprintf(stderr, "[ERROR]: failed to open %s/%s: %s\n", param->tree_path, job->path, strerror(errno));
+        __atomic_store_n(&ctx->error, 1, __ATOMIC_RELAXED);
+        goto out;
+    }
+
+    for (int64_t index = first ; index < last; index++) {
+        if (write_tree_file(ctx, dir_fd, index, worker)) {
+            fprintf(stderr, "[ERROR]: failed to write %s/%s/f%ld: %s\n",
+                param->tree_path, job->path, index, strerror(errno));
+            __atomic_store_n(&ctx->error, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    close(dir_fd);
+
+out:
+    free(job);
+}
+
+static int make_dir(int dir_fd, const char *path)
+{
+    if (mkdirat(dir_fd, path, 0777) && errno != EEXIST) {
+        fprintf(stderr, "[ERROR]: failed to create directory %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Create the directories of every leaf, in order, and hand the leaves to
+ * the pool. Leaf <j> differs from leaf <j - 1> in its last few levels only,
+ * so those are the only ones created.
+ */
+static int submit_leaves(treectx_t *ctx, tpool_t *pool)
+{
+    param_t *param  = ctx->param;
+    int64_t  digits[GENTREE_MAX_DEPTH] = { 0 };
+    int      ends[GENTREE_MAX_DEPTH + 1] = { 0 };   /* length of the path down to every level */
+    char     path[GENTREE_PATH_MAX] = ".";
+
+    for (int64_t leaf = 0 ; leaf < ctx->num_leaves; leaf++) {
+        /* the first level that changes from the previous leaf */
+        int     level = 0;
+        int64_t rest  = leaf;
+        for (int l = ctx->depth - 1 ; l >= 0; l--) {
+            int64_t digit = rest % param->tree_fanout;
+            rest /= param->tree_fanout;
+            if (leaf == 0 || digit != digits[l])
+                level = l;
+            digits[l] = digit;
+        }
+
+        for (int l = level ; l < ctx->depth; l++) {
+            ends[l + 1] = ends[l] + snprintf(path + ends[l], sizeof(path) - ends[l], "%sd%ld",
+                                             l ? "/" : "", digits[l]);
+            if (make_dir(ctx->root_fd, path))
+                return -1;
+            ctx->num_dirs++;
+        }
+
+        treejob_t *job = calloc(1, sizeof(treejob_t));
+        if (!job)
+            return -1;
+        job->ctx  = ctx;
+        job->leaf = leaf;
+        memcpy(job->path, path, sizeof(path));
+        if (ctx->depth == 0)
+            strcpy(job->path, ".");
+
+        if (tpool_submit(pool, populate_leaf, job)) {
+            free(job);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int generate_tree(param_t *param)
+{
+    if (!param || !param->tree_path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int       error = 0;
+    tpool_t  *pool  = NULL;
+    treectx_t ctx   = {
+        .param      = param,
+        .root_fd    = -1,
+        .num_leaves = (param->tree_files + param->tree_dir_files - 1) / param->tree_dir_files,
+    };
+
+    /* as many levels as it takes for the leaves to fit */
+    for (int64_t capacity = 1 ; capacity < ctx.num_leaves; capacity *= param->tree_fanout)
+        ctx.depth++;
+
+    /* the whole tree is the "file" of the statistics */
+    param->filesize = 0;
+    for (int64_t index = 0 ; index < param->tree_files; index++)
+        param->filesize += tree_file_size(param, index);
+
+    if (make_dir(AT_FDCWD, param->tree_path))
+        return -1;
+    ctx.root_fd = open(param->tree_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (ctx.root_fd < 0) {
+        fprintf(stderr, "[ERROR]: failed to open %s: %s\n", param->tree_path, strerror(errno));
+        return -1;
+    }
+
+    ctx.buffers = calloc(param->threads, sizeof(char *));
+    if (!ctx.buffers) {
+        error = -1;
+        goto cleanup;
+    }
+    for (int i = 0 ; i < param->threads; i++) {
+        ctx.buffers[i] = alloc_aligned(param->file_size_max, FUTIL_DIRECT_ALIGNMENT);
+        if (!ctx.buffers[i]) {
+            fprintf(stderr, "[ERROR]: failed to allocate the file buffers: %s\n", strerror(errno));
+            error = -1;
+            goto cleanup;
+        }
+    }
+
+    pool = tpool_create(param->threads, 2 * param->threads);
+    if (!pool) {
+        fprintf(stderr, "[ERROR]: failed to create worker pool: %s\n", strerror(errno));
+        error = -1;
+        goto cleanup;
+    }
+
+    ctx.stats = stats_create(param, param->threads, param->quiet ? 0 : GENTREE_REPORT_INTERVAL_MS);
+    uint64_t start = stats_now();
+
+    if (submit_leaves(&ctx, pool))
+        error = -1;
+    tpool_wait(pool);
+    if (ctx.error)
+        error = -1;
+
+    double seconds = (stats_now() - start) / 1e9;
+    stats_finish(ctx.stats);
+
+    if (!error && !param->quiet) {
+        stats_print(ctx.stats);
+        fprintf(stdout, "[INFO ]: tree %s: %ld files in %ld directories, %.0f files/s\n",
+            param->tree_path, param->tree_files, ctx.num_dirs + 1,
+            seconds > 0 ? param->tree_files / seconds : 0.0);
+    }
+
+    if (!error && param->stats_json && stats_write_json(ctx.stats, param->stats_json))
+        error = -1;
+
+cleanup:
+    tpool_destroy(pool);
+    stats_destroy(ctx.stats);
+    if (ctx.buffers) {
+        for (int i = 0 ; i < param->threads; i++)
+            free(ctx.buffers[i]);
+        free(ctx.buffers);
+    }
+    close(ctx.root_fd);
+
+    return error;
+}
\ No newline at end of file
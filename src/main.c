@@ -1,13 +1,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <errno.h>
 #include <getopt.h>
-#include "genfile.h"
+#include "dfgen.h"
+#include "gencont.h"
+#include "manifest.h"
 #include "utils.h"
 
-#define DEFAULT_FIXED_RATIO 20
-#define DEFAULT_CHUNK_SIZE  65536 /* 64 KB */
+/* options without a short form */
+enum LONG_OPTION {
+    LONG_OPTION_MANIFEST = 256,
+    LONG_OPTION_SEED,
+    LONG_OPTION_INDEX,
+    LONG_OPTION_SKIP_HOLES,
+    LONG_OPTION_VERIFY,
+    LONG_OPTION_MMAP,
+    LONG_OPTION_STATS_JSON,
+    LONG_OPTION_MEM_LIMIT,
+    LONG_OPTION_DICT,
+    LONG_OPTION_DICT_CHUNKS,
+    LONG_OPTION_OVERLAP,
+    LONG_OPTION_COMPRESS_RATIO,
+    LONG_OPTION_PATTERNS,
+    LONG_OPTION_PATTERN_DIST,
+    LONG_OPTION_COPY_RANGE,
+    LONG_OPTION_TREE,
+    LONG_OPTION_TREE_FILES,
+    LONG_OPTION_FANOUT,
+    LONG_OPTION_DIR_FILES,
+    LONG_OPTION_FILE_SIZE,
+    LONG_OPTION_MUTATE,
+    LONG_OPTION_MUTATE_OUT,
+    LONG_OPTION_CHANGE,
+    LONG_OPTION_EDITS,
+    LONG_OPTION_EDIT_MIX,
+    LONG_OPTION_RATE,
+    LONG_OPTION_RATE_PROFILE,
+    LONG_OPTION_DURATION,
+    LONG_OPTION_LOOP,
+    LONG_OPTION_PREALLOC,
+    LONG_OPTION_SYNC,
+    LONG_OPTION_DROP_CACHE,
+    LONG_OPTION_CHECKPOINT,
+    LONG_OPTION_RESUME,
+};
 
 const struct option long_options[] = {
     {"file",           required_argument, NULL, 'f'},
@@ -20,24 +57,62 @@ const struct option long_options[] = {
     {"gen-holes",      no_argument,       NULL, 'H'},
     {"holes-size",     required_argument, NULL, 'O'},
     {"num-holes",      required_argument, NULL, 'N'},
+    {"threads",        required_argument, NULL, 't'},
+    {"engine",         required_argument, NULL, 'E'},
+    {"direct",         no_argument,       NULL, 'D'},
+    {"async",          no_argument,       NULL, 'A'},
+    {"queue-depth",    required_argument, NULL, 'Q'},
+    {"manifest",       required_argument, NULL, LONG_OPTION_MANIFEST},
+    {"seed",           required_argument, NULL, LONG_OPTION_SEED},
+    {"index",          required_argument, NULL, LONG_OPTION_INDEX},
+    {"skip-holes",     no_argument,       NULL, LONG_OPTION_SKIP_HOLES},
+    {"verify",         required_argument, NULL, LONG_OPTION_VERIFY},
+    {"mmap",           no_argument,       NULL, LONG_OPTION_MMAP},
+    {"stats-json",     required_argument, NULL, LONG_OPTION_STATS_JSON},
+    {"mem-limit",      required_argument, NULL, LONG_OPTION_MEM_LIMIT},
+    {"dict",           required_argument, NULL, LONG_OPTION_DICT},
+    {"dict-chunks",    required_argument, NULL, LONG_OPTION_DICT_CHUNKS},
+    {"overlap",        required_argument, NULL, LONG_OPTION_OVERLAP},
+    {"compress-ratio", required_argument, NULL, LONG_OPTION_COMPRESS_RATIO},
+    {"patterns",       required_argument, NULL, LONG_OPTION_PATTERNS},
+    {"pattern-dist",   required_argument, NULL, LONG_OPTION_PATTERN_DIST},
+    {"copy-range",     no_argument,       NULL, LONG_OPTION_COPY_RANGE},
+    {"tree",           required_argument, NULL, LONG_OPTION_TREE},
+    {"tree-files",     required_argument, NULL, LONG_OPTION_TREE_FILES},
+    {"fanout",         required_argument, NULL, LONG_OPTION_FANOUT},
+    {"dir-files",      required_argument, NULL, LONG_OPTION_DIR_FILES},
+    {"file-size",      required_argument, NULL, LONG_OPTION_FILE_SIZE},
+    {"mutate",         required_argument, NULL, LONG_OPTION_MUTATE},
+    {"mutate-out",     required_argument, NULL, LONG_OPTION_MUTATE_OUT},
+    {"change",         required_argument, NULL, LONG_OPTION_CHANGE},
+    {"edits",          required_argument, NULL, LONG_OPTION_EDITS},
+    {"edit-mix",       required_argument, NULL, LONG_OPTION_EDIT_MIX},
+    {"rate",           required_argument, NULL, LONG_OPTION_RATE},
+    {"rate-profile",   required_argument, NULL, LONG_OPTION_RATE_PROFILE},
+    {"duration",       required_argument, NULL, LONG_OPTION_DURATION},
+    {"loop",           required_argument, NULL, LONG_OPTION_LOOP},
+    {"prealloc",       no_argument,       NULL, LONG_OPTION_PREALLOC},
+    {"sync",           required_argument, NULL, LONG_OPTION_SYNC},
+    {"drop-cache",     no_argument,       NULL, LONG_OPTION_DROP_CACHE},
+    {"checkpoint",     required_argument, NULL, LONG_OPTION_CHECKPOINT},
+    {"resume",         no_argument,       NULL, LONG_OPTION_RESUME},
     {"help",           no_argument,       NULL, 'h'},
+    {NULL,             0,                 NULL, 0},
+};
+const static char *short_options = "f:s:r:S:M:m:qHO:N:t:E:DAQ:h";
+
+static param_t g_param;
+
+static const char *pattern_dist_names[PATTERN_DIST_LAST] = {
+    [PATTERN_DIST_UNIFORM] = "uniform",
+    [PATTERN_DIST_ZIPF]    = "zipf",
+    [PATTERN_DIST_HOTCOLD] = "hotcold",
 };
-const static char *short_options = "f:s:r:S:M:m:qHO:N:h";
-
-static param_t g_param = {
-    .filename               = NULL,
-    .filesize               = 0,
-    .fixed_ratio            = DEFAULT_FIXED_RATIO,
-    .non_fixed_ratio        = 100 - DEFAULT_FIXED_RATIO,
-    .fixed_part_size        = 0,
-    .non_fixed_part_size    = 0,
-    .chunk_size             = DEFAULT_CHUNK_SIZE,
-    .chunk_size_min         = DEFAULT_CHUNK_SIZE,
-    .chunk_size_max         = DEFAULT_CHUNK_SIZE,
-    .quiet                  = 0,
-    .enable_holes           = 0,
-    .num_holes              = 0,
-    .holes_size             = 0,
+
+static const char *rate_profile_names[RATE_PROFILE_LAST] = {
+    [RATE_PROFILE_CONSTANT] = "constant",
+    [RATE_PROFILE_SQUARE]   = "square",
+    [RATE_PROFILE_RAMP]     = "ramp",
 };
 
 static void print_usage(const char *progname)
@@ -49,11 +124,14 @@ static void print_usage(const char *progname)
     "Usage:\n"
     "   %s -f <filename> -s <size> [OPTION]..."
     "   This generator will try generating a file with given name <filename> and given size <size>\n"
+    "   %s --manifest <manifest> [OPTION]...\n"
+    "   Generate every file listed in <manifest>, see [MANIFEST]\n"
     "\n"
     "[REQUIRED]:\n"
     "    -f, --file                specify the filename of the generating file\n"
+    "                              \"-f -\" streams the file to stdout instead, see [STREAMING]\n"
     "    -s, --size                specify the size of the generating file\n"
-    "                              support unit = { B, KB, MB, GB }\n"
+    "                              support unit = { B, KB, MB, GB, TB }\n"
     "                              for example: \"-s 100MB\" will generate a file with size 100MB\n"
     "\n"
     "[OPTION]:\n"
@@ -64,7 +142,7 @@ static void print_usage(const char *progname)
     "                              inside the generating file\n"
     "\n"
     "chunks:\n"
-    "    support unit for chunk size = { B, KB, MB }\n"
+    "    support unit for chunk size = { B, KB, MB, GB }, up to 1 GB\n"
     "\n"
     "    -S, --chunk-size          specify the size of each fixed chunks\n"
     "                              default chunk size = 65536 bytes ( 64 KB )\n"
@@ -76,16 +154,141 @@ static void print_usage(const char *progname)
     "    -O, --holes-size          specify the total size of the holes in the generating file\n"
     "    -N, --num-holes           specify the total number of the holes in generating file\n"
     "\n"
+    "performance:\n"
+    "    -t, --threads             number of worker threads filling and writing disjoint ranges\n"
+    "                              of the generating file in parallel, default = 1\n"
+    "    -E, --engine              select the content engine implementation\n"
+    "                              support engine = { auto, avx2, sse4, scalar }, default = auto\n"
+    "    -D, --direct              write with O_DIRECT, bypassing the page cache\n"
+    "    -A, --async               overlap generation and writes with io_uring, falling back\n"
+    "                              to a pwrite thread when io_uring is not available\n"
+    "    -Q, --queue-depth         number of buffers in flight in async mode\n"
+    "                              default = 2 * threads + 2\n"
+    "    --mmap                    generate the content straight into windows of a shared\n"
+    "                              mapping of the file, unmapped as soon as they are written\n"
+    "    --copy-range              write one copy of the fixed chunks and duplicate it over the\n"
+    "                              rest of the fixed part with copy_file_range(), inside the\n"
+    "                              kernel; file systems with reflinks share the blocks instead\n"
+    "    --prealloc                allocate the data ranges of the file with fallocate() before\n"
+    "                              writing them, holes left out, so that it does not fragment\n"
+    "    --sync                    durability of the file, one of none (default), end (fdatasync\n"
+    "                              once written) or every:<size> (also start the writeback of\n"
+    "                              every <size> written per thread, and wait for the one before\n"
+    "                              it, so the dirty pages stay bounded)\n"
+    "    --drop-cache              evict the file from the page cache once written, so that the\n"
+    "                              next reader gets it from the device\n"
+    "    --checkpoint              every <size> written, sync the file and record the seed, the\n"
+    "                              settings and how far the file is on disk in <file>.ckpt\n"
+    "    --resume                  carry on an interrupted generation of <file> from its\n"
+    "                              checkpoint, into the same bytes an uninterrupted run writes;\n"
+    "                              the seed and layout settings come from the checkpoint\n"
+    "    --mem-limit               cap on the buffers of the generating file, ranges are generated\n"
+    "                              in smaller pieces to stay under it, default = 512MB\n"
+    "\n"
+    "    --compress-ratio          make the content compress about <ratio> times, e.g. 2.5, by\n"
+    "                              mixing random literals with repeated tokens,\n"
+    "                              default = 1.0 (incompressible)\n"
+    "    --seed                    seed of the generated content, the same seed and settings\n"
+    "                              always generate the same file, default = derived from the clock\n"
+    "\n"
+    "fixed part:\n"
+    "    --patterns                number of distinct chunks the fixed part repeats, default = 1\n"
+    "    --pattern-dist            popularity of the fixed chunks, one of\n"
+    "                              uniform, zipf[:<skew>] (default skew = 1.0) or\n"
+    "                              hotcold[:<hot%%>:<traffic%%>] (default = 20:80, 20%% of the\n"
+    "                              chunks take 80%% of the fixed part), default = uniform\n"
+    "\n"
+    "cross-file dedup:\n"
+    "    --dict                    draw non-fixed chunks from the shared chunk dictionary <path>,\n"
+    "                              created with -S sized chunks if it does not exist yet, so that\n"
+    "                              every file generated with the same dictionary shares content\n"
+    "    --dict-chunks             number of chunks of a new dictionary, default = 1024\n"
+    "    --overlap                 percentage of the non-fixed chunks drawn from the dictionary\n"
+    "                              support range = [ 0 - 100 ], default = 50\n"
+    "\n"
+    "dedup index:\n"
+    "    --index                   write a ground-truth dedup index of the generated file to <path>:\n"
+    "                              offset, length, kind and fingerprint of every chunk and hole,\n"
+    "                              followed by the unique bytes and the expected dedup ratio\n"
+    "\n"
+    "load:\n"
+    "    --rate                    hold the writes to <size>/s, e.g. 400MB/s, paced by a token\n"
+    "                              bucket shared by the threads, default = as fast as possible\n"
+    "    --rate-profile            shape of the rate over time, one of constant (default),\n"
+    "                              square[:<period>[:<low%%>]] (--rate, then <low%%> of it, half a\n"
+    "                              period each, default = 10:0) or ramp[:<period>] (from 0 up to\n"
+    "                              --rate over <period> seconds, default = 10)\n"
+    "    --duration                stop after <seconds>, rewriting the file until then\n"
+    "    --loop                    write the file <n> times over, or until --duration\n"
+    "\n"
+    "statistics:\n"
+    "    Unless quiet, progress (bytes written, MB/s, chunks/s, ETA and the time split\n"
+    "    between content generation, writes and flushing) is printed every second,\n"
+    "    followed by a final report with the write latency percentiles and the wall\n"
+    "    time of every phase: prealloc, generate and write, sync, drop cache.\n"
+    "\n"
+    "    --stats-json              write the final report as JSON to <path>\n"
+    "\n"
     "others:\n"
     "    -q, --quiet               enable silent mode\n"
     "    -h, --help                display this help text\n"
     "\n"
+    "[MANIFEST]:\n"
+    "    A manifest lists one file per line with the options of that file, for example:\n"
+    "\n"
+    "        # ratio 20, 100 MB, with 4 holes\n"
+    "        -f $HOME/dummy/20/dummy_20_100MB.tmp -s 100MB -r 20 -H -N 4 -O 1MB\n"
+    "\n"
+    "    Options given on the command line are the defaults of every line. Lines are\n"
+    "    generated concurrently by -t workers, one single-threaded file per worker, and\n"
+    "    line <n> gets a seed derived from --seed and <n> unless it sets its own.\n"
+    "    --index and --stats-json write one file each, so they can only be set per line.\n"
+    "    As in a shell, '#' starts a comment at the start of a line or after a blank,\n"
+    "    outside quotes, so \"-f a#1\" names the file a#1.\n"
+    "\n"
+    "[STREAMING]:\n"
+    "    With \"-f -\" the same layout is written, in order, to stdout, for example into a\n"
+    "    dedup ingest process or nc. Pages are handed to a pipe with vmsplice() and to\n"
+    "    sockets and files with splice(), without copying them. Streaming implies -q and\n"
+    "    one thread, and can not be combined with -D or -A.\n"
+    "\n"
+    "    --skip-holes              leave the holes out of the stream instead of sending zeros\n"
+    "\n"
+    "[TREE]:\n"
+    "    --tree <dir>              instead of one file, create a directory tree of small files\n"
+    "                              under <dir>, every file with the -r, -S and --compress-ratio\n"
+    "                              layout and a seed derived from --seed and its number, written\n"
+    "                              by -t workers, e.g.\n"
+    "                              %s --tree <dir> --tree-files 1000000 -t 8 --seed 42\n"
+    "    --tree-files              number of files of the tree\n"
+    "    --fanout                  subdirectories per directory, default = 16\n"
+    "    --dir-files               files per leaf directory, default = 256\n"
+    "    --file-size <min>[:<max>] size range of the files, spread log-uniformly,\n"
+    "                              default = 4KB:1MB\n"
+    "\n"
+    "[MUTATE]:\n"
+    "    --mutate <file>           derive the next generation of <file> with a script of edits\n"
+    "                              drawn from --seed, rewriting only what they touch, e.g.\n"
+    "                              %s --mutate <file> --change 2 --edits 100 --seed 43\n"
+    "    --mutate-out <path>       edit a reflinked copy of <file> at <path> instead of <file>\n"
+    "    --change                  percentage of the file the edits touch, default = 5\n"
+    "    --edits                   number of edits, default = 16\n"
+    "    --edit-mix                weights of overwrite:insert:delete:append:truncate edits,\n"
+    "                              default = 50:20:20:5:5. Inserts and deletes shift the rest of\n"
+    "                              the file, with fallocate() on the file systems that can\n"
+    "\n"
+    "[VERIFY]:\n"
+    "    --verify <file>           check <file> against the content rebuilt from --seed and the\n"
+    "                              other options it was generated with, using -t threads, and\n"
+    "                              report the first mismatching offset of every region, e.g.\n"
+    "                              %s --verify <file> -s 100MB -r 20 --seed 42\n"
+    "\n"
     "Examples:\n"
     "\n"
     "Notes:\n"
     "\n";
 
-    fprintf(stdout, usage, progname, progname);
+    fprintf(stdout, usage, progname, progname, progname, progname, progname, progname);
 }
 
 static void print_info(void)
@@ -97,6 +300,26 @@ static void print_info(void)
     char *chunksize_min_str = bytes_to_unit(g_param.chunk_size_min, UNIT_FORMAT_BYTES_ONLY);
     char *chunksize_max_str = bytes_to_unit(g_param.chunk_size_max, UNIT_FORMAT_BYTES_ONLY);
     char *total_holes_size_str = bytes_to_unit(g_param.holes_size, UNIT_FORMAT_BYTES_ONLY);
+    char  dict_str[64] = "disable";
+    char  patterns_str[64];
+    char  rate_str[64] = "unlimited";
+
+    if (g_param.dict_path)
+        snprintf(dict_str, sizeof(dict_str), "%.30s (%d%% overlap)", g_param.dict_path, g_param.overlap);
+
+    if (g_param.fixed_patterns <= 1)
+        snprintf(patterns_str, sizeof(patterns_str), "1");
+    else if (g_param.pattern_dist == PATTERN_DIST_ZIPF)
+        snprintf(patterns_str, sizeof(patterns_str), "%lld, zipf:%.2f", (long long)g_param.fixed_patterns, g_param.pattern_skew);
+    else if (g_param.pattern_dist == PATTERN_DIST_HOTCOLD)
+        snprintf(patterns_str, sizeof(patterns_str), "%lld, hotcold:%d:%d", (long long)g_param.fixed_patterns,
+                 g_param.hot_ratio, g_param.hot_traffic);
+    else
+        snprintf(patterns_str, sizeof(patterns_str), "%lld, uniform", (long long)g_param.fixed_patterns);
+
+    if (g_param.rate > 0)
+        snprintf(rate_str, sizeof(rate_str), "%.2f MB/s, %s", g_param.rate / 1048576.0,
+                 rate_profile_names[g_param.rate_profile]);
 
     const char *info = ""
     "------------------------------------------------------------------------\n"
@@ -108,6 +331,7 @@ static void print_info(void)
     "|    fixed ratio:         %-3d %%                                        |\n"
     "|    fixed part size:     %-45s|\n"
     "|    non fixed part size: %-45s|\n"
+    "|    fixed patterns:      %-45s|\n"
     "|                                                                      |\n"
     "|[Chunk]                                                               |\n"
     "|    chunk size:          %-24s                     |\n"
@@ -120,6 +344,15 @@ static void print_info(void)
     "|    total size of holes: %-44s |\n"
     "|                                                                      |\n"
     "|[Others]                                                              |\n"
+    "|    threads:             %-44d |\n"
+    "|    content engine:      %-44s |\n"
+    "|    compression ratio:   %-44.2f |\n"
+    "|    seed:                %-44llu |\n"
+    "|    direct I/O:          %-44s |\n"
+    "|    async I/O:           %-44s |\n"
+    "|    mmap I/O:            %-44s |\n"
+    "|    chunk dictionary:    %-44s |\n"
+    "|    rate:                %-44s |\n"
     "|                                                                      |\n"
     "------------------------------------------------------------------------\n"
     "";
@@ -130,12 +363,22 @@ static void print_info(void)
         g_param.fixed_ratio,
         fixed_part_size_str,
         non_fixed_part_size_str,
+        patterns_str,
         chunksize_str,
         chunksize_min_str,
         chunksize_max_str,
         g_param.enable_holes ? "enable" : "disable",
-        g_param.num_holes,
-        total_holes_size_str
+        (long long)g_param.num_holes,
+        total_holes_size_str,
+        g_param.threads,
+        gencont_name(),
+        g_param.compress_ratio,
+        (unsigned long long)g_param.seed,
+        g_param.direct ? "enable" : "disable",
+        g_param.async ? "enable" : "disable",
+        g_param.mmap ? "enable" : "disable",
+        dict_str,
+        rate_str
         );
 
     free(fsize_str);
@@ -147,7 +390,118 @@ static void print_info(void)
     free(total_holes_size_str);
 }
 
-static int parse_cmds(int argc, char **argv)
+/* uniform, zipf[:<skew>] or hotcold[:<hot%>:<traffic%>] */
+static int parse_pattern_dist(param_t *param, const char *arg)
+{
+    int         dist;
+    const char *args;
+    size_t      length = strcspn(arg, ":");
+
+    for (dist = 0 ; dist < PATTERN_DIST_LAST; dist++) {
+        if (strlen(pattern_dist_names[dist]) == length && !strncmp(arg, pattern_dist_names[dist], length))
+            break;
+    }
+    if (dist == PATTERN_DIST_LAST)
+        return -1;
+
+    param->pattern_dist = dist;
+    args = arg[length] == ':' ? arg + length + 1 : NULL;
+
+    switch (dist) {
+    case PATTERN_DIST_ZIPF:
+        if (args)
+            param->pattern_skew = strtod(args, NULL);
+        return param->pattern_skew > 0.0 ? 0 : -1;
+    case PATTERN_DIST_HOTCOLD:
+        if (args && sscanf(args, "%d:%d", &param->hot_ratio, &param->hot_traffic) != 2)
+            return -1;
+        return param->hot_ratio > 0 && param->hot_ratio <= 100 &&
+               param->hot_traffic >= 0 && param->hot_traffic <= 100 ? 0 : -1;
+    default:
+        return args ? -1 : 0;
+    }
+}
+
+/* constant, square[:<period>[:<low%>]] or ramp[:<period>] */
+static int parse_rate_profile(param_t *param, const char *arg)
+{
+    int    profile;
+    size_t length = strcspn(arg, ":");
+
+    for (profile = 0 ; profile < RATE_PROFILE_LAST; profile++) {
+        if (strlen(rate_profile_names[profile]) == length && !strncmp(arg, rate_profile_names[profile], length))
+            break;
+    }
+    if (profile == RATE_PROFILE_LAST)
+        return -1;
+
+    param->rate_profile = profile;
+    if (arg[length] != ':')
+        return 0;
+
+    switch (profile) {
+    case RATE_PROFILE_SQUARE:
+        return sscanf(arg + length + 1, "%lf:%lf", &param->rate_period, &param->rate_low) >= 1 ? 0 : -1;
+    case RATE_PROFILE_RAMP:
+        return sscanf(arg + length + 1, "%lf", &param->rate_period) == 1 ? 0 : -1;
+    default:
+        return -1;
+    }
+}
+
+/* none, end or every:<size> */
+static int parse_sync(param_t *param, const char *arg)
+{
+    if (!strcmp(arg, "none"))
+        param->sync_mode = SYNC_MODE_NONE;
+    else if (!strcmp(arg, "end"))
+        param->sync_mode = SYNC_MODE_END;
+    else if (!strncmp(arg, "every:", 6)) {
+        param->sync_mode  = SYNC_MODE_EVERY;
+        param->sync_every = unit_to_bytes(arg + 6);
+    }
+    else
+        return -1;
+
+    return param->sync_mode != SYNC_MODE_EVERY || param->sync_every > 0 ? 0 : -1;
+}
+
+/* <size>/s, or just <size> */
+static int64_t parse_rate(const char *arg)
+{
+    char *size = strdup(arg);
+    if (!size)
+        return -1;
+
+    char *per = strstr(size, "/s");
+    if (per && per[2] == '\0')
+        *per = '\0';
+
+    int64_t rate = unit_to_bytes(size);
+    free(size);
+
+    return rate;
+}
+
+/* <min>[:<max>], a single size makes every file of the tree that large */
+static int parse_file_size(param_t *param, const char *arg)
+{
+    char *min_str = strdup(arg);
+    if (!min_str)
+        return -1;
+
+    char *max_str = strchr(min_str, ':');
+    if (max_str)
+        *max_str++ = '\0';
+
+    param->file_size_min = unit_to_bytes(min_str);
+    param->file_size_max = max_str ? unit_to_bytes(max_str) : param->file_size_min;
+    free(min_str);
+
+    return param->file_size_min > 0 && param->file_size_max >= param->file_size_min ? 0 : -1;
+}
+
+static int parse_cmds(param_t *param, int argc, char **argv)
 {
     int opt = 0;
 
@@ -155,64 +509,244 @@ static int parse_cmds(int argc, char **argv)
         switch (opt)
         {
         case 'f':
-            g_param.filename = strdup(optarg);
+            param->filename = strdup(optarg);
             break;
         case 's':
-            g_param.filesize = unit_to_bytes(optarg);
-            if (g_param.filesize <= 0) {
+            param->filesize = unit_to_bytes(optarg);
+            if (param->filesize <= 0) {
                 fprintf(stderr, "filesize must be larger than 0 bytes!\n");
                 return -1;
             }
             break;
         case 'r':
-            g_param.fixed_ratio = atoi(optarg);
-            if (g_param.fixed_ratio < 0 || g_param.fixed_ratio > 100) {
+            param->fixed_ratio = atoi(optarg);
+            if (param->fixed_ratio < 0 || param->fixed_ratio > 100) {
                 fprintf(stderr, "fixed ratio should be a integer in range [ 0 - 100 ]\n");
                 return -1;
             }
-            g_param.non_fixed_ratio = 100 - g_param.fixed_ratio;
+            param->non_fixed_ratio = 100 - param->fixed_ratio;
             break;
         case 'S':
-            g_param.chunk_size = unit_to_bytes(optarg);
-            if (g_param.chunk_size <= 0) {
+            param->chunk_size = unit_to_bytes(optarg);
+            if (param->chunk_size <= 0) {
                 fprintf(stderr, "chunksize must be larget than 0 bytes\n");
                 return -1;
             }
             break;
         case 'M':
-            g_param.chunk_size_max = unit_to_bytes(optarg);
-            if (g_param.chunk_size_max <= 0) {
+            param->chunk_size_max = unit_to_bytes(optarg);
+            if (param->chunk_size_max <= 0) {
                 fprintf(stderr, "max chunk size must be larger than 0 bytes\n");
                 return -1;
             }
             break;
         case 'm':
-            g_param.chunk_size_min = unit_to_bytes(optarg);
-            if (g_param.chunk_size_min <= 0) {
+            param->chunk_size_min = unit_to_bytes(optarg);
+            if (param->chunk_size_min <= 0) {
                 fprintf(stderr, "min chunk size must be larger than 0 bytes\n");
                 return -1;
             }
             break;
         case 'q':
-            g_param.quiet = 1;
+            param->quiet = 1;
             break;
         case 'H':
-            g_param.enable_holes = 1;
+            param->enable_holes = 1;
             break;
         case 'O':
-            g_param.holes_size = unit_to_bytes(optarg);
-            if (g_param.holes_size <= 0) {
+            param->holes_size = unit_to_bytes(optarg);
+            if (param->holes_size <= 0) {
                 fprintf(stderr, "total size of the holes must be larger than 0 bytes\n");
                 return -1;
             }
             break;
         case 'N':
-            g_param.num_holes = atoi(optarg);
-            if (g_param.num_holes <= 0) {
+            param->num_holes = strtoll(optarg, NULL, 10);
+            if (param->num_holes <= 0) {
                 fprintf(stderr, "total num of holes should be larger than 0\n");
                 return -1;
             }
             break;
+        case 't':
+            param->threads = atoi(optarg);
+            if (param->threads <= 0) {
+                fprintf(stderr, "number of threads should be larger than 0\n");
+                return -1;
+            }
+            break;
+        case 'E':
+            if (gencont_select(optarg))
+                return -1;
+            break;
+        case 'D':
+            param->direct = 1;
+            break;
+        case 'A':
+            param->async = 1;
+            break;
+        case 'Q':
+            param->queue_depth = atoi(optarg);
+            if (param->queue_depth <= 0) {
+                fprintf(stderr, "queue depth should be larger than 0\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_MANIFEST:
+            param->manifest = strdup(optarg);
+            break;
+        case LONG_OPTION_SEED:
+            param->seed = strtoull(optarg, NULL, 0);
+            break;
+        case LONG_OPTION_INDEX:
+            param->index_path = strdup(optarg);
+            break;
+        case LONG_OPTION_SKIP_HOLES:
+            param->skip_holes = 1;
+            break;
+        case LONG_OPTION_STATS_JSON:
+            param->stats_json = strdup(optarg);
+            break;
+        case LONG_OPTION_MEM_LIMIT:
+            param->mem_limit = unit_to_bytes(optarg);
+            if (param->mem_limit <= 0) {
+                fprintf(stderr, "memory limit must be larger than 0 bytes\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_DICT:
+            param->dict_path = strdup(optarg);
+            break;
+        case LONG_OPTION_DICT_CHUNKS:
+            param->dict_chunks = strtoll(optarg, NULL, 10);
+            if (param->dict_chunks <= 0) {
+                fprintf(stderr, "number of dictionary chunks should be larger than 0\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_OVERLAP:
+            param->overlap = atoi(optarg);
+            if (param->overlap < 0 || param->overlap > 100) {
+                fprintf(stderr, "overlap should be a integer in range [ 0 - 100 ]\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_COMPRESS_RATIO:
+            param->compress_ratio = strtod(optarg, NULL);
+            if (!(param->compress_ratio >= 1.0)) {
+                fprintf(stderr, "compression ratio should be a number not smaller than 1.0\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_PATTERNS:
+            param->fixed_patterns = strtoll(optarg, NULL, 10);
+            if (param->fixed_patterns <= 0) {
+                fprintf(stderr, "number of fixed patterns should be larger than 0\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_PATTERN_DIST:
+            if (parse_pattern_dist(param, optarg)) {
+                fprintf(stderr, "unsupported pattern distribution %s, see --help\n", optarg);
+                return -1;
+            }
+            break;
+        case LONG_OPTION_TREE:
+            param->tree_path = strdup(optarg);
+            break;
+        case LONG_OPTION_TREE_FILES:
+            param->tree_files = strtoll(optarg, NULL, 10);
+            if (param->tree_files <= 0) {
+                fprintf(stderr, "number of files of the tree should be larger than 0\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_FANOUT:
+            param->tree_fanout = atoi(optarg);
+            break;
+        case LONG_OPTION_DIR_FILES:
+            param->tree_dir_files = atoi(optarg);
+            break;
+        case LONG_OPTION_FILE_SIZE:
+            if (parse_file_size(param, optarg)) {
+                fprintf(stderr, "file size should be <min>[:<max>], e.g. 4KB:1MB\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_MUTATE:
+            param->mutate_path = strdup(optarg);
+            break;
+        case LONG_OPTION_MUTATE_OUT:
+            param->mutate_out = strdup(optarg);
+            break;
+        case LONG_OPTION_CHANGE:
+            param->change_ratio = strtod(optarg, NULL);
+            break;
+        case LONG_OPTION_EDITS:
+            param->num_edits = strtoll(optarg, NULL, 10);
+            break;
+        case LONG_OPTION_EDIT_MIX:
+            if (sscanf(optarg, "%d:%d:%d:%d:%d", &param->edit_mix[EDIT_KIND_OVERWRITE],
+                       &param->edit_mix[EDIT_KIND_INSERT], &param->edit_mix[EDIT_KIND_DELETE],
+                       &param->edit_mix[EDIT_KIND_APPEND], &param->edit_mix[EDIT_KIND_TRUNCATE]) != EDIT_KIND_LAST) {
+                fprintf(stderr, "edit mix should be <overwrite>:<insert>:<delete>:<append>:<truncate>\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_RATE:
+            param->rate = parse_rate(optarg);
+            if (param->rate <= 0) {
+                fprintf(stderr, "rate should be a size per second, e.g. 400MB/s\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_RATE_PROFILE:
+            if (parse_rate_profile(param, optarg)) {
+                fprintf(stderr, "rate profile should be constant, square[:<period>[:<low%%>]] or ramp[:<period>]\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_DURATION:
+            param->duration = strtod(optarg, NULL);
+            break;
+        case LONG_OPTION_LOOP:
+            param->loops = strtoll(optarg, NULL, 10);
+            if (param->loops <= 0) {
+                fprintf(stderr, "number of loops should be larger than 0\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_PREALLOC:
+            param->prealloc = 1;
+            break;
+        case LONG_OPTION_SYNC:
+            if (parse_sync(param, optarg)) {
+                fprintf(stderr, "sync should be none, end or every:<size>\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_DROP_CACHE:
+            param->drop_cache = 1;
+            break;
+        case LONG_OPTION_CHECKPOINT:
+            param->checkpoint_interval = unit_to_bytes(optarg);
+            if (param->checkpoint_interval <= 0) {
+                fprintf(stderr, "checkpoint interval should be a size larger than 0 bytes\n");
+                return -1;
+            }
+            break;
+        case LONG_OPTION_RESUME:
+            param->resume = 1;
+            break;
+        case LONG_OPTION_COPY_RANGE:
+            param->copy_range = 1;
+            break;
+        case LONG_OPTION_MMAP:
+            param->mmap = 1;
+            break;
+        case LONG_OPTION_VERIFY:
+            param->filename = strdup(optarg);
+            param->verify   = 1;
+            break;
         case 'h':
         case '?':
         default:
@@ -224,96 +758,78 @@ static int parse_cmds(int argc, char **argv)
     return 0;
 }
 
-static int check_parameters(void)
+/* parse, check and prepare the settings of one manifest line */
+static int parse_manifest_job(param_t *param, int argc, char **argv)
 {
-    int error = 0;
-
-    if (!g_param.filename) {
-        fprintf(stderr, "[ERROR]: must set filename with -f <filename>\n");
-        error++;
-    }
-
-    if (g_param.filesize <= 0) {
-        fprintf(stderr, "[ERROR]: must set filesize >= 0 bytes with -s <size>\n");
-        error++;
-    }
-
-    if (g_param.fixed_ratio < 0 || g_param.fixed_ratio > 100) {
-        fprintf(stderr, "[ERROR]: fixed ratio must be a integer in range [ 0 - 100 ]\n");
-        error++;
-    }
-
-    if (g_param.non_fixed_ratio < 0 || g_param.non_fixed_ratio > 100) {
-        fprintf(stderr, "[ERROR]: invalid non fixed ratio\n");
-        error++;
-    }
-
-    if (g_param.filesize < g_param.chunk_size) {
-        fprintf(stderr, "[ERROR]: chunk size should always smaller than the file size\n");
-        error++;
-    }
-
-    if (g_param.chunk_size_max < g_param.chunk_size_min) {
-        fprintf(stderr, "[ERROR]: max chunk size should always greater or equal to min chunk size\n");
-        error++;
-    }
-
-    if (g_param.enable_holes && g_param.holes_size <= 0) {
-        fprintf(stderr, "[ERROR]: total size of the hole should always greater than 0 bytes\n");
-        error++;
-    }
+    if (parse_cmds(param, argc, argv))
+        return -1;
 
-    if (g_param.enable_holes && g_param.num_holes <= 0) {
-        fprintf(stderr, "[ERROR]: number of holes should greater than 0 if enable generating holes mode\n");
-        error++;
-    }
+    if (dfgen_param_check(param))
+        return -1;
 
-    if (g_param.enable_holes && g_param.num_holes > g_param.holes_size) {
-        fprintf(stderr, "[ERROR]: number of the holes should always smaller than the total size of the holes\n");
-        error++;
+    if (param_is_stream(param)) {
+        fprintf(stderr, "[ERROR]: manifest lines can not stream to stdout\n");
+        return -1;
     }
 
-    return error;
-}
-
-static int prepare_generating_file(void)
-{
-    int64_t filesize = g_param.filesize;
-    g_param.fixed_part_size     = filesize * g_param.fixed_ratio / 100;
-    g_param.non_fixed_part_size = filesize - g_param.fixed_part_size;
-
-    return 0;
+    return dfgen_param_prepare(param);
 }
 
 int main(int argc, char **argv)
 {
-    /* used for generating random content */
-    srand(time(NULL));
+    dfgen_param_init(&g_param);
+    uint64_t default_seed = g_param.seed;
 
-    if (parse_cmds(argc, argv)) {
+    if (parse_cmds(&g_param, argc, argv)) {
         fprintf(stderr, "[WARN ]: Some errors occur when parsing commands\n");
         fprintf(stderr, "[WARN ]: Exiting the program...\n");
         return -1;
     }
 
+    if (g_param.resume && dfgen_param_resume(&g_param))
+        return -1;
+
+    if (g_param.manifest)
+        return run_manifest(g_param.manifest, &g_param, parse_manifest_job) ? -1 : 0;
+
     int num_err = 0;
 
-    if ((num_err = check_parameters()) != 0) {
+    if ((num_err = dfgen_param_check(&g_param)) != 0) {
         fprintf(stderr, "[WARN ]: Total %d errors occur\n", num_err);
         fprintf(stderr, "[WARN ]: Exiting the program...\n");
         return -1;
     }
 
-    if (prepare_generating_file()) {
+    if (dfgen_param_prepare(&g_param)) {
         fprintf(stderr, "[WARN ]: Detect some invalid setting\n");
         fprintf(stderr, "[WARN ]: Exiting the program...\n");
         return -1;
     }
 
-    if (!g_param.quiet)
+    if (g_param.verify && g_param.seed == default_seed) {
+        fprintf(stderr, "[ERROR]: --verify needs the --seed the file was generated with\n");
+        return -1;
+    }
+
+    dfgen_t *gen = dfgen_create(&g_param);
+    if (!gen) {
+        fprintf(stderr, "[ERROR]: failed to set up the generator: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (g_param.verify) {
+        int ret = dfgen_verify(gen);
+        dfgen_destroy(gen);
+        return ret ? -1 : 0;
+    }
+
+    if (!g_param.quiet && !g_param.tree_path && !g_param.mutate_path)
         print_info();
 
-    if (generate_file(&g_param)) {
+    int64_t size = dfgen_run(gen);
+    dfgen_destroy(gen);
+
+    if (size < 0) {
         fprintf(stderr, "[WARN ]: Detect some error when generating file\n");
         fprintf(stderr, "[WARN ]: Exiting the program...\n");
         return -1;
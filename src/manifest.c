@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <wordexp.h>
+#include "manifest.h"
+#include "genfile.h"
+#include "gencont.h"
+#include "tpool.h"
+
+#define MANIFEST_PROGNAME "dfgen"
+
+typedef struct manifest_job_t {
+    param_t  param;
+    int64_t  line;
+    int      quiet;
+    int     *num_failed;
+} manifest_job_t;
+
+static void run_manifest_job(void *arg, int worker)
+{
+    manifest_job_t *job = arg;
+
+    if (generate_file(&job->param)) {
+        fprintf(stderr, "[ERROR]: manifest line %ld: failed to generate %s\n", job->line, job->param.filename);
+        __atomic_add_fetch(job->num_failed, 1, __ATOMIC_RELAXED);
+    }
+    else if (!job->quiet) {
+        fprintf(stdout, "[INFO ]: manifest line %ld: generated %s (seed %llu)\n",
+            job->line, job->param.filename, (unsigned long long)job->param.seed);
+    }
+
+    free(job->param.filename);
+    free(job);
+}
+
+/*
+ * Cut the line at its comment. As in a shell, '#' only starts one at the
+ * start of the line or after a blank, outside quotes, so that file names
+ * may hold it.
+ */
+static void strip_comment(char *line)
+{
+    char quote = '\0';
+
+    for (char *c = line; *c; c++) {
+        if (quote) {
+            if (*c == '\\' && quote == '"' && c[1])
+                c++;
+            else if (*c == quote)
+                quote = '\0';
+        }
+        else if (*c == '\\' && c[1]) {
+            c++;
+        }
+        else if (*c == '\'' || *c == '"') {
+            quote = *c;
+        }
+        else if (*c == '#' && (c == line || *(c - 1) == ' ' || *(c - 1) == '\t')) {
+            *c = '\0';
+            return;
+        }
+    }
+}
+
+/* split one manifest line into an argument vector, with shell-like quoting and $VAR expansion */
+static int parse_manifest_line(const char *line, param_t *param, param_t *defaults, manifest_parse_fn parse)
+{
+    wordexp_t words;
+
+    if (wordexp(line, &words, WRDE_NOCMD | WRDE_UNDEF)) {
+        fprintf(stderr, "[ERROR]: failed to split the line into options\n");
+        return -1;
+    }
+
+    char **argv = calloc(words.we_wordc + 2, sizeof(char *));
+    if (!argv) {
+        wordfree(&words);
+        return -1;
+    }
+    argv[0] = MANIFEST_PROGNAME;
+    for (size_t i = 0 ; i < words.we_wordc; i++)
+        argv[i+1] = words.we_wordv[i];
+
+    /* restart getopt from scratch for every line */
+    optind = 0;
+    param->filename = NULL;
+    int ret = parse(param, words.we_wordc + 1, argv);
+    if (ret == 0 && !param->filename && defaults->filename)
+        param->filename = strdup(defaults->filename);
+
+    free(argv);
+    wordfree(&words);
+
+    return ret;
+}
+
+int run_manifest(const char *path, param_t *defaults, manifest_parse_fn parse)
+{
+    if (!path || !defaults || !parse) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* every line would write the same sidecar at the same time */
+    if (defaults->index_path || defaults->stats_json) {
+        fprintf(stderr, "[ERROR]: --index and --stats-json name one file, set them per manifest line\n");
+        errno = EINVAL;
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "[ERROR]: failed to open manifest %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    /* bounded queue: at most 2 pending jobs per worker are parsed ahead */
+    tpool_t *pool = tpool_create(defaults->threads, 2 * defaults->threads);
+    if (!pool) {
+        fprintf(stderr, "[ERROR]: failed to create worker pool: %s\n", strerror(errno));
+        fclose(fp);
+        return -1;
+    }
+
+    char    *line       = NULL;
+    size_t   line_cap   = 0;
+    int64_t  line_no    = 0;
+    int64_t  num_jobs   = 0;
+    int      num_failed = 0;
+    int      error      = 0;
+
+    while (getline(&line, &line_cap, fp) >= 0) {
+        line_no++;
+
+        /* wordexp() rejects newlines */
+        line[strcspn(line, "\r\n")] = '\0';
+        strip_comment(line);
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue;
+
+        manifest_job_t *job = calloc(1, sizeof(manifest_job_t));
+        if (!job) {
+            error = -1;
+            break;
+        }
+        job->param            = *defaults;
+        job->param.seed       = gencont_derive(defaults->seed, line_no);
+        job->param.manifest   = NULL;
+        job->line             = line_no;
+        job->quiet            = defaults->quiet;
+        job->num_failed       = &num_failed;
+
+        if (parse_manifest_line(line, &job->param, defaults, parse)) {
+            fprintf(stderr, "[ERROR]: %s:%ld: invalid job, skipped\n", path, line_no);
+            free(job->param.filename);
+            free(job);
+            /* the workers count their failures at the same time */
+            __atomic_add_fetch(&num_failed, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        /* jobs are spread over the workers, each file is generated by a single one */
+        job->param.threads = 1;
+        job->param.quiet   = 1;
+
+        num_jobs++;
+        if (tpool_submit(pool, run_manifest_job, job)) {
+            free(job->param.filename);
+            free(job);
+            error = -1;
+            break;
+        }
+    }
+
+    tpool_wait(pool);
+    tpool_destroy(pool);
+    free(line);
+    fclose(fp);
+
+    num_failed = __atomic_load_n(&num_failed, __ATOMIC_ACQUIRE);
+
+    if (!defaults->quiet)
+        fprintf(stdout, "[INFO ]: manifest %s: %ld jobs, %d failed\n", path, num_jobs, num_failed);
+
+    return (error || num_failed) ? -1 : 0;
+}
\ No newline at end of file
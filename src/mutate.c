@@ -0,0 +1,335 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#include "mutate.h"
+#include "futil.h"
+#include "gencont.h"
+#include "sink.h"
+#include "utils.h"
+
+#define min(a,b) (((a)>(b))?(b):(a))
+
+/* new content and moved tails go through a buffer of this size */
+#define MUTATE_BUFFER_SIZE (4LL * 1024 * 1024)
+
+/*
+ * The edit script is drawn from --seed, one edit at a time against the
+ * current size of the file:
+ *
+ *   overwrite  new bytes over [ offset, offset + length )
+ *   insert     new bytes at <offset>, the rest of the file moves up
+ *   delete     [ offset, offset + length ) goes, the rest moves down
+ *   append     new bytes at the end
+ *   truncate   the last <length> bytes go
+ *
+ * Edits are --change percent of the file in total, over --edits edits of
+ * random length around the mean. Inserts and deletes are aligned to the
+ * file system block so that fallocate() INSERT_RANGE and COLLAPSE_RANGE
+ * can shift the extents without touching the data. Where the file system
+ * can not, the tail is moved by hand, which costs I/O as large as the tail.
+ */
+
+static const char *edit_kind_names[EDIT_KIND_LAST] = {
+    [EDIT_KIND_OVERWRITE] = "overwrite",
+    [EDIT_KIND_INSERT]    = "insert",
+    [EDIT_KIND_DELETE]    = "delete",
+    [EDIT_KIND_APPEND]    = "append",
+    [EDIT_KIND_TRUNCATE]  = "truncate",
+};
+
+typedef struct mutctx_t {
+    param_t  *param;
+    int       fd;
+    int64_t   size;
+    int64_t   block;
+    char     *buf;
+    uint64_t  key;
+    int       no_shift;                 /* no INSERT_RANGE / COLLAPSE_RANGE here */
+    int64_t   written;
+    int64_t   moved;
+    int64_t   count[EDIT_KIND_LAST];
+    int64_t   bytes[EDIT_KIND_LAST];
+} mutctx_t;
+
+/* the new bytes of edit <edit>, a stream of their own */
+static int write_fresh(mutctx_t *ctx, int64_t edit, int64_t offset, int64_t length)
+{
+    uint64_t key = gencont_hash64(ctx->key, edit);
+
+    for (int64_t pos = 0 ; pos < length; ) {
+        int64_t available = min(length - pos, MUTATE_BUFFER_SIZE);
+        gencont_fill(key, ctx->param->compress_ratio, pos, ctx->buf, available);
+        if (pwrite_full(ctx->fd, ctx->buf, available, offset + pos))
+            return -1;
+        pos += available;
+    }
+    ctx->written += length;
+
+    return 0;
+}
+
+static int copy_piece(mutctx_t *ctx, int64_t from, int64_t to, int64_t length)
+{
+    int64_t got = 0;
+
+    while (got < length) {
+        ssize_t ret = pread(ctx->fd, ctx->buf + got, length - got, from + got);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (ret == 0) {
+            errno = EIO;
+            return -1;
+        }
+        got += ret;
+    }
+    ctx->moved += length;
+
+    return pwrite_full(ctx->fd, ctx->buf, length, to);
+}
+
+/* move [ offset, size ) by <delta> bytes, back to front when it moves up */
+static int move_tail(mutctx_t *ctx, int64_t offset, int64_t delta)
+{
+    int64_t end = ctx->size;
+
+    if (delta > 0) {
+        for (int64_t pos = end ; pos > offset; ) {
+            int64_t length = min(pos - offset, MUTATE_BUFFER_SIZE);
+            pos -= length;
+            if (copy_piece(ctx, pos, pos + delta, length))
+                return -1;
+        }
+        return 0;
+    }
+
+    for (int64_t pos = offset ; pos < end; ) {
+        int64_t length = min(end - pos, MUTATE_BUFFER_SIZE);
+        if (copy_piece(ctx, pos, pos + delta, length))
+            return -1;
+        pos += length;
+    }
+
+    return ftruncate(ctx->fd, end + delta);
+}
+
+/* shift [ offset, size ) by <delta> bytes, moving the extents when the file system allows */
+static int shift_tail(mutctx_t *ctx, int64_t offset, int64_t delta)
+{
+    if (!ctx->no_shift) {
+        int mode = delta > 0 ? FALLOC_FL_INSERT_RANGE : FALLOC_FL_COLLAPSE_RANGE;
+        if (delta > 0 ? !fallocate(ctx->fd, mode, offset, delta) : !fallocate(ctx->fd, mode, offset + delta, -delta))
+            return 0;
+        if (errno != EOPNOTSUPP && errno != EINVAL)
+            return -1;
+
+        ctx->no_shift = 1;
+        fprintf(stderr, "[WARN ]: %s can not shift extents, inserts and deletes move the data instead\n",
+            ctx->param->mutate_out ? ctx->param->mutate_out : ctx->param->mutate_path);
+    }
+
+    return move_tail(ctx, offset, delta);
+}
+
+static int64_t align_down(int64_t value, int64_t block)
+{
+    return value / block * block;
+}
+
+static int apply_edit(mutctx_t *ctx, prng_t *prng, int64_t edit, int64_t mean)
+{
+    param_t *param  = ctx->param;
+    int      total  = 0;
+    int      kind   = 0;
+    int64_t  length = mean / 2 + prng_bounded(prng, mean + 1);  /* [ mean / 2, 3 * mean / 2 ] */
+    int64_t  offset = 0;
+
+    for (int k = 0 ; k < EDIT_KIND_LAST; k++)
+        total += param->edit_mix[k];
+    for (int64_t pick = prng_bounded(prng, total); pick >= param->edit_mix[kind]; kind++)
+        pick -= param->edit_mix[kind];
+
+    /* shifting edits inside the file move whole blocks, they need a block to work on */
+    if ((kind == EDIT_KIND_INSERT || kind == EDIT_KIND_DELETE) && ctx->size < 2 * ctx->block)
+        kind = EDIT_KIND_APPEND;
+    if ((kind == EDIT_KIND_OVERWRITE || kind == EDIT_KIND_TRUNCATE) && ctx->size == 0)
+        kind = EDIT_KIND_APPEND;
+
+    switch (kind) {
+    case EDIT_KIND_OVERWRITE:
+        length = min(length, ctx->size);
+        offset = prng_bounded(prng, ctx->size - length + 1);
+        if (write_fresh(ctx, edit, offset, length))
+            return -1;
+        break;
+    case EDIT_KIND_INSERT:
+        length = align_down(length, ctx->block) > 0 ? align_down(length, ctx->block) : ctx->block;
+        offset = align_down(prng_bounded(prng, ctx->size - ctx->block), ctx->block);
+        if (shift_tail(ctx, offset, length) || write_fresh(ctx, edit, offset, length))
+            return -1;
+        ctx->size += length;
+        break;
+    case EDIT_KIND_DELETE:
+        length = align_down(length, ctx->block) > 0 ? align_down(length, ctx->block) : ctx->block;
+        /* COLLAPSE_RANGE must leave something behind */
+        length = min(length, align_down(ctx->size - 1, ctx->block));
+        offset = align_down(prng_bounded(prng, ctx->size - length), ctx->block);
+        if (shift_tail(ctx, offset + length, -length))
+            return -1;
+        ctx->size -= length;
+        break;
+    case EDIT_KIND_APPEND:
+        offset = ctx->size;
+        if (write_fresh(ctx, edit, offset, length))
+            return -1;
+        ctx->size += length;
+        break;
+    case EDIT_KIND_TRUNCATE:
+        length = min(length, ctx->size);
+        offset = ctx->size - length;
+        if (ftruncate(ctx->fd, offset))
+            return -1;
+        ctx->size = offset;
+        break;
+    }
+
+    ctx->count[kind]++;
+    ctx->bytes[kind] += length;
+
+    if (!param->quiet)
+        fprintf(stdout, "[INFO ]: edit %ld: %-9s %ld bytes at %ld\n", edit, edit_kind_names[kind], length, offset);
+
+    return 0;
+}
+
+/* the generation to edit: the file itself, or a reflinked copy of it */
+static int open_target(param_t *param)
+{
+    if (!param->mutate_out)
+        return open(param->mutate_path, O_RDWR | O_CLOEXEC);
+
+    int src = open(param->mutate_path, O_RDONLY | O_CLOEXEC);
+    if (src < 0)
+        return -1;
+
+    int dst = open(param->mutate_out, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (dst < 0) {
+        close(src);
+        return -1;
+    }
+
+    if (ioctl(dst, FICLONE, src)) {
+        /* no shared extents here, copy the data instead, in the kernel if possible */
+        struct stat st;
+        fprintf(stderr, "[WARN ]: can not reflink %s (%s), copying it\n", param->mutate_path, strerror(errno));
+        if (fstat(src, &st))
+            goto error;
+        for (loff_t in = 0, out = 0; in < st.st_size; ) {
+            ssize_t ret = copy_file_range(src, &in, dst, &out, st.st_size - in, 0);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                goto error;
+        }
+    }
+
+    close(src);
+    return dst;
+
+error:
+    close(src);
+    close(dst);
+    return -1;
+}
+
+int mutate_file(param_t *param)
+{
+    if (!param || !param->mutate_path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int      error = 0;
+    mutctx_t ctx   = {
+        .param = param,
+        .key   = gencont_derive(param->seed, GENCONT_STREAM_MUTATE),
+    };
+    struct stat st;
+    prng_t      prng;
+
+    ctx.fd = open_target(param);
+    if (ctx.fd < 0) {
+        fprintf(stderr, "[ERROR]: failed to open %s: %s\n",
+            param->mutate_out ? param->mutate_out : param->mutate_path, strerror(errno));
+        return -1;
+    }
+
+    if (fstat(ctx.fd, &st)) {
+        error = -1;
+        goto cleanup;
+    }
+    ctx.size  = st.st_size;
+    ctx.block = st.st_blksize > 0 ? st.st_blksize : FUTIL_DIRECT_ALIGNMENT;
+
+    ctx.buf = alloc_aligned(MUTATE_BUFFER_SIZE, FUTIL_DIRECT_ALIGNMENT);
+    if (!ctx.buf) {
+        error = -1;
+        goto cleanup;
+    }
+
+    int64_t change  = st.st_size * param->change_ratio / 100;
+    int64_t mean    = change / param->num_edits > 0 ? change / param->num_edits : 1;
+    int64_t initial = ctx.size;
+
+    /* the edits draw their stream from the content key, the script from a stream of its own */
+    prng_seed(&prng, gencont_derive(ctx.key, 0));
+
+    for (int64_t edit = 0 ; edit < param->num_edits; edit++) {
+        if (apply_edit(&ctx, &prng, edit, mean)) {
+            fprintf(stderr, "[ERROR]: edit %ld failed: %s\n", edit, strerror(errno));
+            error = -1;
+            break;
+        }
+    }
+
+    if (!error && fsync(ctx.fd))
+        error = -1;
+
+    if (!error && !param->quiet) {
+        char *before  = bytes_to_unit(initial, UNIT_FORMAT_NORMAL);
+        char *after   = bytes_to_unit(ctx.size, UNIT_FORMAT_NORMAL);
+        char *written = bytes_to_unit(ctx.written, UNIT_FORMAT_NORMAL);
+        char *moved   = bytes_to_unit(ctx.moved, UNIT_FORMAT_NORMAL);
+        fprintf(stdout, "[INFO ]: %s: %ld edits (seed %llu), %s -> %s, wrote %s, moved %s\n",
+            param->mutate_out ? param->mutate_out : param->mutate_path, param->num_edits,
+            (unsigned long long)param->seed, before, after, written, moved);
+        for (int k = 0 ; k < EDIT_KIND_LAST; k++) {
+            if (ctx.count[k])
+                fprintf(stdout, "[INFO ]:     %-9s %ld edits, %ld bytes\n", edit_kind_names[k], ctx.count[k], ctx.bytes[k]);
+        }
+        free(before);
+        free(after);
+        free(written);
+        free(moved);
+    }
+
+    if (param->output)
+        param->output->size = error ? -1 : ctx.size;
+
+cleanup:
+    free(ctx.buf);
+    if (close(ctx.fd))
+        error = -1;
+
+    return error;
+}
\ No newline at end of file
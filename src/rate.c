@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "rate.h"
+#include "stats.h"
+
+struct rate_t {
+    int             profile;
+    double          rate;       /* bytes per second at the top of the profile */
+    double          low;        /* bytes per second in the low half of a square wave */
+    double          period;     /* of the square wave, or length of the ramp, in seconds */
+    double          burst;      /* bytes of credit kept for writers behind */
+    uint64_t        start;
+    uint64_t        deadline;   /* 0 without --duration */
+    double          reserved;   /* bytes handed out so far, lost credit included */
+    int64_t         shortfall;  /* credit lost */
+    pthread_mutex_t lock;
+};
+
+/* bytes due <t> seconds after the start */
+static double rate_allowance(const rate_t *rate, double t)
+{
+    switch (rate->profile) {
+    case RATE_PROFILE_SQUARE: {
+        double half  = rate->period / 2;
+        double k     = floor(t / rate->period);
+        double phase = t - k * rate->period;
+        double due   = k * (rate->rate + rate->low) * half;
+        return due + (phase < half ? rate->rate * phase : rate->rate * half + rate->low * (phase - half));
+    }
+    case RATE_PROFILE_RAMP:
+        if (t < rate->period)
+            return rate->rate * t * t / (2 * rate->period);
+        return rate->rate * (t - rate->period / 2);
+    default:
+        return rate->rate * t;
+    }
+}
+
+/* the inverse: seconds after the start at which <bytes> are due */
+static double rate_time(const rate_t *rate, double bytes)
+{
+    switch (rate->profile) {
+    case RATE_PROFILE_SQUARE: {
+        double half = rate->period / 2;
+        double high = rate->rate * half;
+        double k    = floor(bytes / (high + rate->low * half));
+        double left = bytes - k * (high + rate->low * half);
+        if (left <= high)
+            return k * rate->period + left / rate->rate;
+        return k * rate->period + half + (left - high) / rate->low;
+    }
+    case RATE_PROFILE_RAMP:
+        if (bytes < rate->rate * rate->period / 2)
+            return sqrt(2 * rate->period * bytes / rate->rate);
+        return bytes / rate->rate + rate->period / 2;
+    default:
+        return bytes / rate->rate;
+    }
+}
+
+rate_t *rate_create(const param_t *param)
+{
+    if (!param) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    rate_t *rate = calloc(1, sizeof(rate_t));
+    if (!rate)
+        return NULL;
+
+    rate->profile = param->rate_profile;
+    rate->rate    = param->rate;
+    rate->low     = param->rate * param->rate_low / 100;
+    rate->period  = param->rate_period;
+    rate->burst   = param->rate * RATE_BURST_MS / 1000.0;
+    rate->start   = stats_now();
+    if (param->duration > 0)
+        rate->deadline = rate->start + (uint64_t)(param->duration * 1e9);
+    pthread_mutex_init(&rate->lock, NULL);
+
+    return rate;
+}
+
+int rate_pace(rate_t *rate, int64_t bytes)
+{
+    if (!rate)
+        return 0;
+
+    uint64_t now = stats_now();
+    if (rate->deadline && now >= rate->deadline)
+        return 1;
+    if (rate->rate <= 0)
+        return 0;
+
+    /* the first byte of the reservation is due at <first> */
+    pthread_mutex_lock(&rate->lock);
+    double due = rate_allowance(rate, (now - rate->start) / 1e9);
+    if (due - rate->reserved > rate->burst) {
+        rate->shortfall += due - rate->burst - rate->reserved;
+        rate->reserved   = due - rate->burst;
+    }
+    double first = rate->reserved;
+    rate->reserved += bytes;
+    pthread_mutex_unlock(&rate->lock);
+
+    uint64_t release = rate->start + (uint64_t)(rate_time(rate, first) * 1e9);
+    if (rate->deadline && release >= rate->deadline)
+        return 1;
+    if (release <= now)
+        return 0;
+
+    struct timespec ts = {
+        .tv_sec  = release / 1000000000ULL,
+        .tv_nsec = release % 1000000000ULL,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+
+    return 0;
+}
+
+int rate_expired(rate_t *rate)
+{
+    return rate && rate->deadline && stats_now() >= rate->deadline;
+}
+
+double rate_due(rate_t *rate, uint64_t now)
+{
+    if (!rate || rate->rate <= 0)
+        return 0;
+
+    return rate_allowance(rate, (now - rate->start) / 1e9);
+}
+
+int64_t rate_shortfall(rate_t *rate)
+{
+    if (!rate)
+        return 0;
+
+    pthread_mutex_lock(&rate->lock);
+    int64_t shortfall = rate->shortfall;
+    pthread_mutex_unlock(&rate->lock);
+
+    return shortfall;
+}
+
+void rate_destroy(rate_t *rate)
+{
+    if (!rate)
+        return;
+
+    pthread_mutex_destroy(&rate->lock);
+    free(rate);
+}
\ No newline at end of file
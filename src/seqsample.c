@@ -0,0 +1,142 @@
+#include <math.h>
+#include "seqsample.h"
+
+/* Method D is worth it while n is less than 1/13 of N */
+#define SEQSAMPLE_ALPHA 13
+
+/* uniform in ( 0, 1 ), never 0 so that it can go through log() */
+static inline double uniform(prng_t *prng)
+{
+    return ((prng_next(prng) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+void seqsample_init(seqsample_t *sample, uint64_t seed, int64_t n, int64_t N)
+{
+    if (N < 0)
+        N = 0;
+    if (n > N)
+        n = N;
+    if (n < 0)
+        n = 0;
+
+    prng_seed(&sample->prng, seed);
+    sample->n        = n;
+    sample->N        = N;
+    sample->position = 0;
+    sample->method_a = SEQSAMPLE_ALPHA * n >= N;
+    sample->vprime   = n > 0 ? exp(log(uniform(&sample->prng)) / n) : 0;
+}
+
+/* number of records to skip before the next selected one, Method A */
+static int64_t skip_method_a(seqsample_t *sample)
+{
+    double  v    = uniform(&sample->prng);
+    double  top  = sample->N - sample->n;
+    double  Nr   = sample->N;
+    double  quot = top / Nr;
+    int64_t S    = 0;
+
+    while (quot > v) {
+        S++;
+        top--;
+        Nr--;
+        quot = quot * top / Nr;
+    }
+
+    return S;
+}
+
+/* number of records to skip before the next selected one, Method D */
+static int64_t skip_method_d(seqsample_t *sample)
+{
+    int64_t n        = sample->n;
+    int64_t N        = sample->N;
+    double  nreal    = n;
+    double  Nreal    = N;
+    double  ninv     = 1.0 / nreal;
+    double  nmin1inv = 1.0 / (nreal - 1.0);
+    int64_t qu1      = N - n + 1;
+    double  qu1real  = Nreal - nreal + 1.0;
+    double  vprime   = sample->vprime;
+    int64_t S;
+
+    for (;;) {
+        double x;
+
+        /* S = floor(X) with X from the enveloping distribution */
+        for (;;) {
+            x = Nreal * (1.0 - vprime);
+            S = (int64_t)x;
+            if (S < qu1)
+                break;
+            vprime = exp(log(uniform(&sample->prng)) * ninv);
+        }
+
+        double u        = uniform(&sample->prng);
+        double negSreal = -(double)S;
+        double y1       = exp(log(u * Nreal / qu1real) * nmin1inv);
+
+        /* quick acceptance, vprime is then already valid for n - 1 */
+        vprime = y1 * (1.0 - x / Nreal) * (qu1real / (negSreal + qu1real));
+        if (vprime <= 1.0)
+            break;
+
+        double  y2  = 1.0;
+        double  top = Nreal - 1.0;
+        double  bottom;
+        int64_t limit;
+
+        if (n - 1 > S) {
+            bottom = Nreal - nreal;
+            limit  = N - S;
+        }
+        else {
+            bottom = Nreal + negSreal - 1.0;
+            limit  = qu1;
+        }
+        for (int64_t t = N - 1; t >= limit; t--) {
+            y2 = y2 * top / bottom;
+            top--;
+            bottom--;
+        }
+
+        if (Nreal / (Nreal - x) >= y1 * exp(log(y2) * nmin1inv)) {
+            vprime = exp(log(uniform(&sample->prng)) * nmin1inv);
+            break;
+        }
+        vprime = exp(log(uniform(&sample->prng)) * ninv);
+    }
+
+    sample->vprime = vprime;
+
+    return S;
+}
+
+int64_t seqsample_next(seqsample_t *sample)
+{
+    int64_t S;
+
+    if (sample->n <= 0)
+        return -1;
+
+    if (!sample->method_a && SEQSAMPLE_ALPHA * sample->n >= sample->N)
+        sample->method_a = 1;
+
+    if (sample->n == 1) {
+        S = (int64_t)(sample->N * uniform(&sample->prng));
+        if (S >= sample->N)
+            S = sample->N - 1;
+    }
+    else if (sample->method_a)
+        S = skip_method_a(sample);
+    else
+        S = skip_method_d(sample);
+
+    int64_t index = sample->position + S;
+
+    sample->position  = index + 1;
+    sample->N        -= S + 1;
+    sample->n--;
+
+    return index;
+}
\ No newline at end of file
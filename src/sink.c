@@ -0,0 +1,389 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sink.h"
+#include "futil.h"
+
+#define min(a,b) (((a)>(b))?(b):(a))
+
+#define SINK_ALIGNMENT FUTIL_DIRECT_ALIGNMENT
+
+/*
+ * --sync every:<size>: the span of the file a worker wrote since its last
+ * write-behind, and the span before it. The spans of different workers
+ * overlap, which costs nothing: sync_file_range() skips clean pages.
+ */
+struct sink_writeback_t {
+    int64_t offset;
+    int64_t end;
+    int64_t bytes;
+    int64_t prev_offset;
+    int64_t prev_end;
+} __attribute__((aligned(64)));
+
+static int sink_write_behind(sink_t *sink, int worker, int64_t offset, int64_t length)
+{
+    if (!sink->writeback)
+        return 0;
+
+    sink_writeback_t *wb = &sink->writeback[worker];
+
+    if (wb->bytes == 0 || offset < wb->offset)
+        wb->offset = offset;
+    if (wb->bytes == 0 || offset + length > wb->end)
+        wb->end = offset + length;
+    wb->bytes += length;
+
+    if (wb->bytes < sink->param->sync_every)
+        return 0;
+
+    int error = sync_behind(sink->fd, wb->offset, wb->end - wb->offset, wb->prev_offset, wb->prev_end - wb->prev_offset);
+    wb->prev_offset = wb->offset;
+    wb->prev_end    = wb->end;
+    wb->bytes       = 0;
+
+    return error;
+}
+
+void *sink_default_acquire(sink_t *sink, int worker, int64_t offset, int64_t length)
+{
+    /* keep the buffer congruent to the file offset, so aligned I/O stays possible */
+    return sink->buffers[worker] + offset % SINK_ALIGNMENT;
+}
+
+int sink_create_flags(const param_t *param)
+{
+    return O_CREAT | (param->resume ? 0 : O_TRUNC);
+}
+
+int sink_close_fd(sink_t *sink, int64_t total_size)
+{
+    int error = 0;
+
+    if (sink->fd < 0)
+        return 0;
+
+    /* trailing holes only exist once the file has been extended over them */
+    if (total_size >= 0 && ftruncate(sink->fd, total_size)) {
+        fprintf(stderr, "[ERROR]: failed to extend the target file: %s\n", strerror(errno));
+        error = -1;
+    }
+
+    if (close(sink->fd))
+        error = -1;
+    sink->fd = -1;
+
+    return error;
+}
+
+/* buffered pwrite() through the page cache */
+
+static int sink_pwrite_open(sink_t *sink)
+{
+    /* copy_file_range() reads what it duplicates back from the same descriptor */
+    int mode = sink->param->copy_range ? O_RDWR : O_WRONLY;
+
+    sink->fd = open(sink->param->filename, mode | sink_create_flags(sink->param), 0666);
+    return sink->fd < 0 ? -1 : 0;
+}
+
+static int sink_pwrite_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    return pwrite_full(sink->fd, buf, length, offset);
+}
+
+static int sink_pwrite_write(sink_t *sink, int worker, const void *buf, int64_t offset, int64_t length)
+{
+    return pwrite_full(sink->fd, buf, length, offset);
+}
+
+static int sink_pwrite_repeat(sink_t *sink, int worker, const void *buf, int64_t period, int64_t skew,
+                              int64_t offset, int64_t length)
+{
+    return pwrite_repeat(sink->fd, buf, period, skew, length, offset,
+                         sink->param->copy_range ? FUTIL_REPEAT_COPY : 0);
+}
+
+/*
+ * O_DIRECT writes, bypassing the page cache.
+ *
+ * The block-aligned middle of every range goes through the O_DIRECT
+ * descriptor. Whatever is left over at either end (ranges next to a hole,
+ * the end of the file) does not cover a whole block and is written through
+ * a second, buffered descriptor instead.
+ */
+
+typedef struct sink_direct_t {
+    int fd_buffered;
+} sink_direct_t;
+
+static int sink_direct_open(sink_t *sink)
+{
+    sink_direct_t *direct = calloc(1, sizeof(sink_direct_t));
+    if (!direct)
+        return -1;
+    direct->fd_buffered = -1;
+    sink->priv = direct;
+
+    sink->fd = open(sink->param->filename, O_WRONLY | O_DIRECT | sink_create_flags(sink->param), 0666);
+    if (sink->fd < 0) {
+        if (errno == EINVAL)
+            fprintf(stderr, "[ERROR]: the file system of %s does not support O_DIRECT\n", sink->param->filename);
+        return -1;
+    }
+
+    direct->fd_buffered = open(sink->param->filename, O_WRONLY);
+    if (direct->fd_buffered < 0)
+        return -1;
+
+    return 0;
+}
+
+static int sink_direct_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    sink_direct_t *direct = sink->priv;
+    char          *data   = buf;
+    int64_t        begin  = (offset + SINK_ALIGNMENT - 1) / SINK_ALIGNMENT * SINK_ALIGNMENT;
+    int64_t        end    = (offset + length) / SINK_ALIGNMENT * SINK_ALIGNMENT;
+
+    if (begin >= end)
+        return pwrite_full(direct->fd_buffered, data, length, offset);
+
+    if (begin > offset && pwrite_full(direct->fd_buffered, data, begin - offset, offset))
+        return -1;
+
+    if (pwrite_full(sink->fd, data + (begin - offset), end - begin, begin))
+        return -1;
+
+    if (offset + length > end && pwrite_full(direct->fd_buffered, data + (end - offset), offset + length - end, end))
+        return -1;
+
+    return 0;
+}
+
+static int sink_direct_close(sink_t *sink, int64_t total_size)
+{
+    sink_direct_t *direct = sink->priv;
+    int            error  = 0;
+
+    if (direct) {
+        if (direct->fd_buffered >= 0 && close(direct->fd_buffered))
+            error = -1;
+        free(direct);
+        sink->priv = NULL;
+    }
+
+    if (sink_close_fd(sink, total_size))
+        error = -1;
+
+    return error;
+}
+
+static const sink_ops_t sink_pwrite_ops = {
+    .name    = "pwrite",
+    .open    = sink_pwrite_open,
+    .acquire = sink_default_acquire,
+    .commit  = sink_pwrite_commit,
+    .write   = sink_pwrite_write,
+    .repeat  = sink_pwrite_repeat,
+    .close   = sink_close_fd,
+};
+
+static const sink_ops_t sink_direct_ops = {
+    .name    = "direct",
+    .open    = sink_direct_open,
+    .acquire = sink_default_acquire,
+    .commit  = sink_direct_commit,
+    .close   = sink_direct_close,
+};
+
+static const sink_ops_t *sink_ops[] = {
+    [SINK_TYPE_PWRITE]   = &sink_pwrite_ops,
+    [SINK_TYPE_DIRECT]   = &sink_direct_ops,
+    [SINK_TYPE_ASYNC]    = &sink_async_ops,
+    [SINK_TYPE_STREAM]   = &sink_stream_ops,
+    [SINK_TYPE_MMAP]     = &sink_mmap_ops,
+    [SINK_TYPE_CALLBACK] = &sink_callback_ops,
+    [SINK_TYPE_BUFFER]   = &sink_buffer_ops,
+    [SINK_TYPE_MEMFD]    = &sink_memfd_ops,
+};
+
+sink_t *sink_create(int type, param_t *param, int num_workers, int64_t buffer_size)
+{
+    if (type < 0 || type >= SINK_TYPE_LAST || !param || num_workers <= 0 || buffer_size <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    sink_t *sink = calloc(1, sizeof(sink_t));
+    if (!sink)
+        return NULL;
+
+    sink->ops         = sink_ops[type];
+    sink->param       = param;
+    sink->num_workers = num_workers;
+    sink->buffer_size = buffer_size;
+    sink->fd          = -1;
+
+    /* sinks with their own buffer management do not need per-worker buffers */
+    if (sink->ops->acquire == sink_default_acquire) {
+        sink->buffers = calloc(num_workers, sizeof(char *));
+        if (!sink->buffers)
+            goto error;
+
+        /* room for the skew in front and a partial block behind */
+        for (int i = 0 ; i < num_workers; i++) {
+            sink->buffers[i] = alloc_aligned(buffer_size + 2 * SINK_ALIGNMENT, SINK_ALIGNMENT);
+            if (!sink->buffers[i])
+                goto error;
+        }
+    }
+
+    if (sink->ops->open(sink)) {
+        fprintf(stderr, "[ERROR]: failed to open %s with the %s sink: %s\n",
+            param->filename, sink->ops->name, strerror(errno));
+        goto error;
+    }
+
+    struct stat st;
+    if (param->sync_mode == SYNC_MODE_EVERY && sink->fd >= 0 && !fstat(sink->fd, &st) && S_ISREG(st.st_mode)) {
+        sink->writeback = alloc_aligned(num_workers * sizeof(sink_writeback_t), sizeof(sink_writeback_t));
+        if (!sink->writeback)
+            goto error;
+    }
+
+    return sink;
+
+error:
+    sink_destroy(sink, -1);
+    return NULL;
+}
+
+/* how many buffers of buffer_size a sink of <type> will hold, so callers can size them under a cap */
+int sink_num_buffers(int type, param_t *param, int num_workers)
+{
+    if (type < 0 || type >= SINK_TYPE_LAST || !param || num_workers <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const sink_ops_t *ops = sink_ops[type];
+
+    if (ops->num_buffers)
+        return ops->num_buffers(param, num_workers);
+
+    return ops->acquire == sink_default_acquire ? num_workers : 0;
+}
+
+void *sink_acquire(sink_t *sink, int worker, int64_t offset, int64_t length)
+{
+    if (length > sink->buffer_size) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return sink->ops->acquire(sink, worker, offset, length);
+}
+
+int sink_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    if (sink->ops->commit(sink, worker, buf, offset, length))
+        return -1;
+
+    return sink_write_behind(sink, worker, offset, length);
+}
+
+int sink_write(sink_t *sink, int worker, const void *buf, int64_t offset, int64_t length)
+{
+    if (sink->ops->write) {
+        if (sink->ops->write(sink, worker, buf, offset, length))
+            return -1;
+        return sink_write_behind(sink, worker, offset, length);
+    }
+
+    const char *curptr    = buf;
+    int64_t     processed = 0;
+
+    while (processed < length) {
+        int64_t available = min(length - processed, sink->buffer_size);
+        void   *dst       = sink_acquire(sink, worker, offset + processed, available);
+        if (!dst)
+            return -1;
+        memcpy(dst, curptr + processed, available);
+        if (sink_commit(sink, worker, dst, offset + processed, available))
+            return -1;
+        processed += available;
+    }
+
+    return 0;
+}
+
+/*
+ * Write <length> bytes at <offset> repeating the <period> bytes of <buf>
+ * from <skew> on: byte i is buf[(skew + i) % period]. Sinks that can hand
+ * the same buffer over many times per call do so, the others get it one
+ * period at a time.
+ */
+int sink_repeat(sink_t *sink, int worker, const void *buf, int64_t period, int64_t skew,
+                int64_t offset, int64_t length)
+{
+    if (period <= 0 || skew < 0 || skew >= period) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sink->ops->repeat) {
+        if (sink->ops->repeat(sink, worker, buf, period, skew, offset, length))
+            return -1;
+        return sink_write_behind(sink, worker, offset, length);
+    }
+
+    for (int64_t processed = 0 ; processed < length; skew = 0) {
+        int64_t available = min(length - processed, period - skew);
+        if (sink_write(sink, worker, (const char *)buf + skew, offset + processed, available))
+            return -1;
+        processed += available;
+    }
+
+    return 0;
+}
+
+void sink_begin(sink_t *sink, int worker, int kind)
+{
+    if (sink->ops->begin)
+        sink->ops->begin(sink, worker, kind);
+}
+
+int sink_hole(sink_t *sink, int64_t offset, int64_t length)
+{
+    if (sink->ops->hole)
+        return sink->ops->hole(sink, offset, length);
+
+    return 0;
+}
+
+int sink_destroy(sink_t *sink, int64_t total_size)
+{
+    int error = 0;
+
+    if (!sink)
+        return 0;
+
+    if (sink->ops->close(sink, total_size))
+        error = -1;
+
+    if (sink->buffers) {
+        for (int i = 0 ; i < sink->num_workers; i++)
+            free(sink->buffers[i]);
+        free(sink->buffers);
+    }
+    free(sink->writeback);
+    free(sink);
+
+    return error;
+}
\ No newline at end of file
@@ -0,0 +1,563 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "sink.h"
+#include "futil.h"
+
+/*
+ * Asynchronous sink.
+ *
+ * A fixed set of <queue depth> buffers is shared by all workers. A worker
+ * takes a free buffer, fills it and commits it; the commit only queues the
+ * write, so the worker goes on generating the next buffer while the device
+ * is busy with the previous ones. A buffer becomes free again when its
+ * write completes.
+ *
+ * Writes are issued through io_uring with the buffers registered up front
+ * (IORING_OP_WRITE_FIXED). When io_uring is not available, a dedicated
+ * writer thread issuing plain pwrite()s takes its place.
+ */
+
+#define SINK_ALIGNMENT FUTIL_DIRECT_ALIGNMENT
+
+typedef struct async_write_t {
+    int     index;
+    char   *data;
+    int64_t offset;
+    int64_t length;
+} async_write_t;
+
+typedef struct async_done_t {
+    async_write_t write;
+    int64_t       res;
+} async_done_t;
+
+typedef struct sink_async_t {
+    int             fd_buffered;
+    int             use_uring;
+    int             queue_depth;
+    int64_t         slot_size;
+    char           *arena;
+    int            *free_slots;
+    int             num_free;
+    int             in_flight;
+    int             error;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+
+    /* io_uring */
+    int             ring_fd;
+    void           *sq_ptr;
+    size_t          sq_size;
+    void           *cq_ptr;
+    size_t          cq_size;
+    struct io_uring_sqe *sqes;
+    size_t          sqes_size;
+    unsigned       *sq_head;
+    unsigned       *sq_tail;
+    unsigned       *sq_mask;
+    unsigned       *sq_array;
+    unsigned       *cq_head;
+    unsigned       *cq_tail;
+    unsigned       *cq_mask;
+    struct io_uring_cqe *cqes;
+    async_write_t  *pending;
+    async_done_t   *done;
+    int             reaping;
+
+    /* pwrite thread fallback */
+    pthread_t       writer;
+    int             writer_started;
+    int             shutdown;
+    async_write_t  *queue;
+    int             queue_head;
+    int             queue_count;
+
+    /* statistics */
+    uint64_t        num_writes;
+    uint64_t        in_flight_sum;
+    int             max_in_flight;
+    int64_t         bytes;
+    struct timespec start;
+} sink_async_t;
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int async_uring_setup(sink_async_t *async)
+{
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    async->ring_fd = io_uring_setup(async->queue_depth, &p);
+    if (async->ring_fd < 0)
+        return -1;
+
+    async->sq_size   = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    async->cq_size   = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    async->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (async->cq_size > async->sq_size)
+            async->sq_size = async->cq_size;
+        async->cq_size = 0;
+    }
+
+    async->sq_ptr = mmap(NULL, async->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        async->ring_fd, IORING_OFF_SQ_RING);
+    if (async->sq_ptr == MAP_FAILED) {
+        async->sq_ptr = NULL;
+        return -1;
+    }
+
+    if (async->cq_size) {
+        async->cq_ptr = mmap(NULL, async->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            async->ring_fd, IORING_OFF_CQ_RING);
+        if (async->cq_ptr == MAP_FAILED) {
+            async->cq_ptr = NULL;
+            return -1;
+        }
+    }
+    char *cq_ptr = async->cq_size ? async->cq_ptr : async->sq_ptr;
+    char *sq_ptr = async->sq_ptr;
+
+    async->sqes = mmap(NULL, async->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        async->ring_fd, IORING_OFF_SQES);
+    if (async->sqes == MAP_FAILED) {
+        async->sqes = NULL;
+        return -1;
+    }
+
+    async->sq_head  = (unsigned *)(sq_ptr + p.sq_off.head);
+    async->sq_tail  = (unsigned *)(sq_ptr + p.sq_off.tail);
+    async->sq_mask  = (unsigned *)(sq_ptr + p.sq_off.ring_mask);
+    async->sq_array = (unsigned *)(sq_ptr + p.sq_off.array);
+    async->cq_head  = (unsigned *)(cq_ptr + p.cq_off.head);
+    async->cq_tail  = (unsigned *)(cq_ptr + p.cq_off.tail);
+    async->cq_mask  = (unsigned *)(cq_ptr + p.cq_off.ring_mask);
+    async->cqes     = (struct io_uring_cqe *)(cq_ptr + p.cq_off.cqes);
+
+    /* register every slot, so the kernel does not map the pages on each write */
+    struct iovec *iovecs = calloc(async->queue_depth, sizeof(struct iovec));
+    if (!iovecs)
+        return -1;
+    for (int i = 0 ; i < async->queue_depth; i++) {
+        iovecs[i].iov_base = async->arena + i * async->slot_size;
+        iovecs[i].iov_len  = async->slot_size;
+    }
+    int ret = io_uring_register(async->ring_fd, IORING_REGISTER_BUFFERS, iovecs, async->queue_depth);
+    free(iovecs);
+    if (ret < 0)
+        return -1;
+
+    /* each write in flight holds a slot, so a reap never finds more completions */
+    async->pending = calloc(async->queue_depth, sizeof(async_write_t));
+    async->done    = calloc(async->queue_depth, sizeof(async_done_t));
+    if (!async->pending || !async->done)
+        return -1;
+
+    return 0;
+}
+
+static void async_uring_teardown(sink_async_t *async)
+{
+    if (async->sqes)
+        munmap(async->sqes, async->sqes_size);
+    if (async->cq_ptr)
+        munmap(async->cq_ptr, async->cq_size);
+    if (async->sq_ptr)
+        munmap(async->sq_ptr, async->sq_size);
+    if (async->ring_fd >= 0)
+        close(async->ring_fd);
+    async->ring_fd = -1;
+    async->sqes    = NULL;
+    async->cq_ptr  = NULL;
+    async->sq_ptr  = NULL;
+    free(async->pending);
+    free(async->done);
+    async->pending = NULL;
+    async->done    = NULL;
+}
+
+/* called without the lock: a short write is finished synchronously, it should hardly ever happen */
+static int64_t async_finish_short(sink_t *sink, async_write_t *w, int64_t res)
+{
+    if (res < 0 || res >= w->length)
+        return res;
+    if (pwrite_full(sink->fd, w->data + res, w->length - res, w->offset + res))
+        return -errno;
+    return w->length;
+}
+
+/* called with the lock held, once the write of a slot is over */
+static void async_complete(sink_t *sink, sink_async_t *async, async_write_t *w, int64_t res)
+{
+    if (res < 0) {
+        fprintf(stderr, "[ERROR]: asynchronous write of %ld bytes at offset %ld failed: %s\n",
+            w->length, w->offset, strerror(-res));
+        async->error = 1;
+    }
+    else {
+        async->bytes += w->length;
+    }
+
+    async->free_slots[async->num_free++] = w->index;
+    async->in_flight--;
+    pthread_cond_broadcast(&async->cond);
+}
+
+/*
+ * Called with the lock held: reap the completed writes, first waiting for
+ * one when <wait> is set. A single worker reaps at a time, and it drops the
+ * lock while it waits for the device or finishes a short write, so the other
+ * workers keep committing meanwhile.
+ */
+static int async_uring_reap(sink_t *sink, sink_async_t *async, int wait)
+{
+    int error    = 0;
+    int unlocked = 0;
+    int count    = 0;
+
+    if (async->reaping)
+        return 0;
+    async->reaping = 1;
+
+    if (wait) {
+        pthread_mutex_unlock(&async->lock);
+        unlocked = 1;
+        while (io_uring_enter(async->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+            if (errno != EINTR) {
+                error = -1;
+                break;
+            }
+        }
+        pthread_mutex_lock(&async->lock);
+    }
+
+    unsigned head = *async->cq_head;
+    unsigned tail = __atomic_load_n(async->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (!error && head != tail) {
+        struct io_uring_cqe *cqe = &async->cqes[head & *async->cq_mask];
+        async->done[count].write = async->pending[cqe->user_data];
+        async->done[count].res   = cqe->res;
+        count++;
+        head++;
+    }
+    __atomic_store_n(async->cq_head, head, __ATOMIC_RELEASE);
+
+    int short_writes = 0;
+    for (int i = 0 ; i < count; i++) {
+        if (async->done[i].res >= 0 && async->done[i].res < async->done[i].write.length)
+            short_writes = 1;
+    }
+    if (short_writes) {
+        pthread_mutex_unlock(&async->lock);
+        unlocked = 1;
+        for (int i = 0 ; i < count; i++)
+            async->done[i].res = async_finish_short(sink, &async->done[i].write, async->done[i].res);
+        pthread_mutex_lock(&async->lock);
+    }
+
+    for (int i = 0 ; i < count; i++)
+        async_complete(sink, async, &async->done[i].write, async->done[i].res);
+
+    async->reaping = 0;
+    if (unlocked)
+        pthread_cond_broadcast(&async->cond);
+
+    return error;
+}
+
+static int async_uring_submit(sink_t *sink, sink_async_t *async, async_write_t *w)
+{
+    unsigned tail = *async->sq_tail;
+    unsigned idx  = tail & *async->sq_mask;
+
+    struct io_uring_sqe *sqe = &async->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_WRITE_FIXED;
+    sqe->fd        = sink->fd;
+    sqe->addr      = (uint64_t)(uintptr_t)w->data;
+    sqe->len       = w->length;
+    sqe->off       = w->offset;
+    sqe->buf_index = w->index;
+    sqe->user_data = w->index;
+
+    async->pending[w->index] = *w;
+    async->sq_array[idx] = idx;
+    __atomic_store_n(async->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (io_uring_enter(async->ring_fd, 1, 0, 0) < 0) {
+        if (errno != EINTR)
+            return -1;
+    }
+
+    return async_uring_reap(sink, async, 0);
+}
+
+static void *async_writer_main(void *arg)
+{
+    sink_t       *sink  = arg;
+    sink_async_t *async = sink->priv;
+
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        while (async->queue_count == 0 && !async->shutdown)
+            pthread_cond_wait(&async->cond, &async->lock);
+        if (async->queue_count == 0)
+            break;
+
+        async_write_t w = async->queue[async->queue_head];
+        async->queue_head = (async->queue_head + 1) % async->queue_depth;
+        async->queue_count--;
+        pthread_mutex_unlock(&async->lock);
+
+        int64_t res = pwrite_full(sink->fd, w.data, w.length, w.offset) ? -errno : w.length;
+
+        pthread_mutex_lock(&async->lock);
+        async_complete(sink, async, &w, res);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    return NULL;
+}
+
+static int sink_async_num_buffers(param_t *param, int num_workers)
+{
+    int queue_depth = param->queue_depth > 0 ? param->queue_depth : 2 * num_workers + 2;
+
+    /* with a slot per worker in hand, at least one more must be free or in flight */
+    if (queue_depth <= num_workers)
+        queue_depth = num_workers + 1;
+
+    return queue_depth;
+}
+
+static int sink_async_open(sink_t *sink)
+{
+    param_t      *param = sink->param;
+    sink_async_t *async = calloc(1, sizeof(sink_async_t));
+    if (!async)
+        return -1;
+    async->fd_buffered = -1;
+    async->ring_fd     = -1;
+    async->queue_depth = sink_async_num_buffers(param, sink->num_workers);
+    async->slot_size   = (sink->buffer_size + 2 * SINK_ALIGNMENT + SINK_ALIGNMENT - 1) / SINK_ALIGNMENT * SINK_ALIGNMENT;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->cond, NULL);
+    sink->priv = async;
+
+    async->arena      = alloc_aligned(async->slot_size * async->queue_depth, SINK_ALIGNMENT);
+    async->free_slots = calloc(async->queue_depth, sizeof(int));
+    async->queue      = calloc(async->queue_depth, sizeof(async_write_t));
+    if (!async->arena || !async->free_slots || !async->queue)
+        return -1;
+    for (int i = 0 ; i < async->queue_depth; i++)
+        async->free_slots[async->num_free++] = async->queue_depth - 1 - i;
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | (param->direct ? O_DIRECT : 0);
+    sink->fd = open(param->filename, flags, 0666);
+    if (sink->fd < 0) {
+        if (errno == EINVAL && param->direct)
+            fprintf(stderr, "[ERROR]: the file system of %s does not support O_DIRECT\n", param->filename);
+        return -1;
+    }
+
+    if (param->direct) {
+        async->fd_buffered = open(param->filename, O_WRONLY);
+        if (async->fd_buffered < 0)
+            return -1;
+    }
+
+    async->use_uring = (async_uring_setup(async) == 0);
+    if (!async->use_uring) {
+        async_uring_teardown(async);
+        if (!param->quiet)
+            fprintf(stdout, "[INFO ]: io_uring is not available (%s), using a pwrite thread\n", strerror(errno));
+        if (pthread_create(&async->writer, NULL, async_writer_main, sink))
+            return -1;
+        async->writer_started = 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &async->start);
+
+    return 0;
+}
+
+static void *sink_async_acquire(sink_t *sink, int worker, int64_t offset, int64_t length)
+{
+    sink_async_t *async = sink->priv;
+    int           index = -1;
+
+    pthread_mutex_lock(&async->lock);
+    while (async->num_free == 0) {
+        if (async->use_uring && async->in_flight > 0 && !async->reaping) {
+            if (async_uring_reap(sink, async, 1))
+                break;
+        }
+        else {
+            pthread_cond_wait(&async->cond, &async->lock);
+        }
+    }
+    if (async->num_free > 0)
+        index = async->free_slots[--async->num_free];
+    pthread_mutex_unlock(&async->lock);
+
+    if (index < 0)
+        return NULL;
+
+    return async->arena + index * async->slot_size + offset % SINK_ALIGNMENT;
+}
+
+static int sink_async_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    sink_async_t *async = sink->priv;
+    char         *data  = buf;
+    async_write_t w     = {
+        .index  = (data - async->arena) / async->slot_size,
+        .data   = data,
+        .offset = offset,
+        .length = length,
+    };
+
+    if (sink->param->direct) {
+        /* partial blocks at either end go through the buffered descriptor */
+        int64_t begin = (offset + SINK_ALIGNMENT - 1) / SINK_ALIGNMENT * SINK_ALIGNMENT;
+        int64_t end   = (offset + length) / SINK_ALIGNMENT * SINK_ALIGNMENT;
+
+        if (begin >= end) {
+            begin = end = offset + length;
+        }
+        if (begin > offset && pwrite_full(async->fd_buffered, data, begin - offset, offset))
+            return -1;
+        if (offset + length > end && pwrite_full(async->fd_buffered, data + (end - offset), offset + length - end, end))
+            return -1;
+
+        w.data   = data + (begin - offset);
+        w.offset = begin;
+        w.length = end - begin;
+    }
+
+    int ret = 0;
+
+    pthread_mutex_lock(&async->lock);
+    if (w.length == 0) {
+        async->free_slots[async->num_free++] = w.index;
+        pthread_cond_broadcast(&async->cond);
+        pthread_mutex_unlock(&async->lock);
+        return 0;
+    }
+
+    async->in_flight++;
+    async->num_writes++;
+    async->in_flight_sum += async->in_flight;
+    if (async->in_flight > async->max_in_flight)
+        async->max_in_flight = async->in_flight;
+
+    if (async->use_uring) {
+        ret = async_uring_submit(sink, async, &w);
+    }
+    else {
+        int tail = (async->queue_head + async->queue_count) % async->queue_depth;
+        async->queue[tail] = w;
+        async->queue_count++;
+        pthread_cond_broadcast(&async->cond);
+    }
+    if (async->error)
+        ret = -1;
+    pthread_mutex_unlock(&async->lock);
+
+    return ret;
+}
+
+static int sink_async_close(sink_t *sink, int64_t total_size)
+{
+    sink_async_t *async = sink->priv;
+    int           error = 0;
+
+    if (!async)
+        return 0;
+
+    pthread_mutex_lock(&async->lock);
+    while (async->in_flight > 0) {
+        if (async->use_uring && !async->reaping) {
+            if (async_uring_reap(sink, async, 1)) {
+                error = -1;
+                break;
+            }
+        }
+        else {
+            pthread_cond_wait(&async->cond, &async->lock);
+        }
+    }
+    async->shutdown = 1;
+    pthread_cond_broadcast(&async->cond);
+    pthread_mutex_unlock(&async->lock);
+
+    if (async->writer_started)
+        pthread_join(async->writer, NULL);
+
+    if (async->error)
+        error = -1;
+
+    if (!sink->param->quiet && async->num_writes > 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - async->start.tv_sec) + (now.tv_nsec - async->start.tv_nsec) / 1e9;
+        fprintf(stdout, "[INFO ]: %s writer: %lu writes, queue depth avg %.2f / max %d of %d, %.2f MB/s\n",
+            async->use_uring ? "io_uring" : "pwrite thread",
+            async->num_writes,
+            (double)async->in_flight_sum / async->num_writes,
+            async->max_in_flight,
+            async->queue_depth,
+            elapsed > 0 ? async->bytes / elapsed / (1024 * 1024) : 0.0);
+    }
+
+    async_uring_teardown(async);
+    if (async->fd_buffered >= 0 && close(async->fd_buffered))
+        error = -1;
+    free(async->arena);
+    free(async->free_slots);
+    free(async->queue);
+    pthread_mutex_destroy(&async->lock);
+    pthread_cond_destroy(&async->cond);
+    free(async);
+    sink->priv = NULL;
+
+    if (sink_close_fd(sink, total_size))
+        error = -1;
+
+    return error;
+}
+
+const sink_ops_t sink_async_ops = {
+    .name        = "async",
+    .open        = sink_async_open,
+    .acquire     = sink_async_acquire,
+    .commit      = sink_async_commit,
+    .close       = sink_async_close,
+    .num_buffers = sink_async_num_buffers,
+};
@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "sink.h"
+
+/*
+ * In-memory sinks of the library, see dfgen.h.
+ *
+ * callback: every range goes to a function of the caller, straight from the
+ *           buffer it was generated in.
+ * buffer:   the file is generated in place in a buffer of the caller.
+ * memfd:    the same, into the mapping of an anonymous memory file that is
+ *           handed to the caller once the file is complete.
+ */
+
+typedef struct sink_callback_t {
+    int *kinds;   /* kind of the range every worker is on */
+} sink_callback_t;
+
+static int sink_callback_open(sink_t *sink)
+{
+    sink_callback_t *cb = calloc(1, sizeof(sink_callback_t));
+    if (!cb)
+        return -1;
+    sink->priv = cb;
+
+    cb->kinds = calloc(sink->num_workers, sizeof(int));
+    return cb->kinds ? 0 : -1;
+}
+
+static void sink_callback_begin(sink_t *sink, int worker, int kind)
+{
+    sink_callback_t *cb = sink->priv;
+
+    cb->kinds[worker] = kind;
+}
+
+static int sink_callback_call(sink_t *sink, const void *buf, int64_t offset, int64_t length, int kind)
+{
+    sink_output_t *output = sink->param->output;
+
+    if (output->callback(output->arg, buf, offset, length, kind)) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sink_callback_write(sink_t *sink, int worker, const void *buf, int64_t offset, int64_t length)
+{
+    sink_callback_t *cb = sink->priv;
+
+    return sink_callback_call(sink, buf, offset, length, cb->kinds[worker]);
+}
+
+static int sink_callback_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    return sink_callback_write(sink, worker, buf, offset, length);
+}
+
+static int sink_callback_hole(sink_t *sink, int64_t offset, int64_t length)
+{
+    return sink_callback_call(sink, NULL, offset, length, DFGEN_KIND_HOLE);
+}
+
+static int sink_callback_close(sink_t *sink, int64_t total_size)
+{
+    sink_callback_t *cb = sink->priv;
+
+    if (cb) {
+        free(cb->kinds);
+        free(cb);
+        sink->priv = NULL;
+    }
+
+    return 0;
+}
+
+/* buffer and memfd: the whole file is one flat mapping */
+
+typedef struct sink_flat_t {
+    char    *map;
+    int64_t  size;
+} sink_flat_t;
+
+static char *sink_flat_at(sink_t *sink, int64_t offset, int64_t length)
+{
+    sink_flat_t *flat = sink->priv;
+
+    if (offset < 0 || length < 0 || offset + length > flat->size) {
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    return flat->map + offset;
+}
+
+static void *sink_flat_acquire(sink_t *sink, int worker, int64_t offset, int64_t length)
+{
+    return sink_flat_at(sink, offset, length);
+}
+
+static int sink_flat_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    return 0;
+}
+
+static int sink_flat_write(sink_t *sink, int worker, const void *buf, int64_t offset, int64_t length)
+{
+    char *dst = sink_flat_at(sink, offset, length);
+    if (!dst)
+        return -1;
+    memcpy(dst, buf, length);
+
+    return 0;
+}
+
+static int sink_buffer_open(sink_t *sink)
+{
+    sink_flat_t *flat = calloc(1, sizeof(sink_flat_t));
+    if (!flat)
+        return -1;
+    sink->priv = flat;
+
+    flat->map  = sink->param->output->buffer;
+    flat->size = sink->param->output->buffer_size;
+
+    return 0;
+}
+
+/* the buffer may hold anything, so holes are cleared */
+static int sink_buffer_hole(sink_t *sink, int64_t offset, int64_t length)
+{
+    char *dst = sink_flat_at(sink, offset, length);
+    if (!dst)
+        return -1;
+    memset(dst, 0, length);
+
+    return 0;
+}
+
+static int sink_buffer_close(sink_t *sink, int64_t total_size)
+{
+    free(sink->priv);
+    sink->priv = NULL;
+
+    return 0;
+}
+
+static int sink_memfd_open(sink_t *sink)
+{
+    sink_flat_t *flat = calloc(1, sizeof(sink_flat_t));
+    if (!flat)
+        return -1;
+    sink->priv = flat;
+
+    sink->fd = memfd_create("dfgen", MFD_CLOEXEC);
+    if (sink->fd < 0)
+        return -1;
+
+    /* large enough for every hole, close() trims it to the size actually planned */
+    flat->size = sink->param->filesize;
+    if (sink->param->enable_holes)
+        flat->size += sink->param->holes_size;
+    if (ftruncate(sink->fd, flat->size))
+        return -1;
+
+    flat->map = mmap(NULL, flat->size, PROT_READ | PROT_WRITE, MAP_SHARED, sink->fd, 0);
+    if (flat->map == MAP_FAILED) {
+        flat->map = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sink_memfd_close(sink_t *sink, int64_t total_size)
+{
+    sink_flat_t *flat  = sink->priv;
+    int          error = 0;
+
+    if (flat) {
+        if (flat->map && munmap(flat->map, flat->size))
+            error = -1;
+        free(flat);
+        sink->priv = NULL;
+    }
+
+    /* a complete file is handed over, a failed one is dropped */
+    if (sink->fd >= 0 && total_size >= 0 && !error) {
+        if (ftruncate(sink->fd, total_size))
+            error = -1;
+        sink->param->output->memfd = sink->fd;
+        sink->fd = -1;
+    }
+
+    if (sink_close_fd(sink, -1))
+        error = -1;
+
+    return error;
+}
+
+const sink_ops_t sink_callback_ops = {
+    .name        = "callback",
+    .open        = sink_callback_open,
+    .acquire     = sink_default_acquire,
+    .commit      = sink_callback_commit,
+    .write       = sink_callback_write,
+    .close       = sink_callback_close,
+    .begin       = sink_callback_begin,
+    .hole        = sink_callback_hole,
+};
+
+const sink_ops_t sink_buffer_ops = {
+    .name        = "buffer",
+    .open        = sink_buffer_open,
+    .acquire     = sink_flat_acquire,
+    .commit      = sink_flat_commit,
+    .write       = sink_flat_write,
+    .close       = sink_buffer_close,
+    .hole        = sink_buffer_hole,
+};
+
+const sink_ops_t sink_memfd_ops = {
+    .name        = "memfd",
+    .open        = sink_memfd_open,
+    .acquire     = sink_flat_acquire,
+    .commit      = sink_flat_commit,
+    .write       = sink_flat_write,
+    .close       = sink_memfd_close,
+};
\ No newline at end of file
@@ -0,0 +1,90 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "sink.h"
+
+/*
+ * Memory-mapped sink.
+ *
+ * The target is sized up front and every range gets its own shared mapping
+ * (a window), so the content engine writes straight into the page cache
+ * instead of into a buffer that write() then copies. Committing a window
+ * starts its writeback and unmaps it, which keeps the resident set bounded
+ * by the ranges in flight whatever the file size. Holes are never mapped.
+ */
+
+typedef struct sink_mmap_t {
+    int64_t page_size;
+} sink_mmap_t;
+
+static int sink_mmap_open(sink_t *sink)
+{
+    sink_mmap_t *mm = calloc(1, sizeof(sink_mmap_t));
+    if (!mm)
+        return -1;
+    mm->page_size = sysconf(_SC_PAGESIZE);
+    sink->priv = mm;
+
+    sink->fd = open(sink->param->filename, O_RDWR | sink_create_flags(sink->param), 0666);
+    if (sink->fd < 0)
+        return -1;
+
+    /* large enough for every hole, close() trims it to the size actually planned */
+    int64_t size = sink->param->filesize;
+    if (sink->param->enable_holes)
+        size += sink->param->holes_size;
+
+    return ftruncate(sink->fd, size);
+}
+
+static void *sink_mmap_acquire(sink_t *sink, int worker, int64_t offset, int64_t length)
+{
+    sink_mmap_t *mm   = sink->priv;
+    int64_t      skew = offset % mm->page_size;
+
+    char *window = mmap(NULL, skew + length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        sink->fd, offset - skew);
+    if (window == MAP_FAILED)
+        return NULL;
+    madvise(window, skew + length, MADV_SEQUENTIAL);
+
+    return window + skew;
+}
+
+static int sink_mmap_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    sink_mmap_t *mm     = sink->priv;
+    int64_t      skew   = offset % mm->page_size;
+    char        *window = (char *)buf - skew;
+    int          error  = 0;
+
+    /* start the writeback now rather than leaving it all to the end */
+    if (sync_file_range(sink->fd, offset, length, SYNC_FILE_RANGE_WRITE) && errno != ESPIPE)
+        error = -1;
+
+    if (munmap(window, skew + length))
+        error = -1;
+
+    return error;
+}
+
+static int sink_mmap_close(sink_t *sink, int64_t total_size)
+{
+    free(sink->priv);
+    sink->priv = NULL;
+
+    return sink_close_fd(sink, total_size);
+}
+
+const sink_ops_t sink_mmap_ops = {
+    .name    = "mmap",
+    .open    = sink_mmap_open,
+    .acquire = sink_mmap_acquire,
+    .commit  = sink_mmap_commit,
+    .close   = sink_mmap_close,
+};
\ No newline at end of file
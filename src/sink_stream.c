@@ -0,0 +1,331 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/sockios.h>
+#include "sink.h"
+#include "futil.h"
+
+/*
+ * Stream sink: the generated file is sent, in order, to standard output.
+ *
+ * When stdout is a pipe, the buffers are handed to it with vmsplice(), so
+ * the kernel references the pages instead of copying them. Anything else
+ * (a socket, a file, a device) gets the pages through a private pipe and
+ * splice(). If the target refuses splice, plain write()s are used.
+ *
+ * A page handed over this way must not change until the reader has taken
+ * it, so generated ranges go to a ring of buffers, and a buffer is only
+ * refilled once the bytes still queued on the target (FIONREAD on a pipe,
+ * SIOCOUTQ on a socket) no longer include it. The fixed part and the zero
+ * runs are spliced straight from buffers that never change.
+ *
+ * Ranges must be committed in file order, which holds with one worker.
+ */
+
+#define STREAM_RING_SLOTS  4
+#define STREAM_PIPE_SIZE   (1024 * 1024)
+#define STREAM_ZERO_SIZE   (1024 * 1024)
+#define STREAM_POLL_MS     1
+
+enum STREAM_MODE {
+    STREAM_MODE_VMSPLICE = 0, /* stdout is a pipe */
+    STREAM_MODE_SPLICE   = 1, /* through a private pipe */
+    STREAM_MODE_WRITE    = 2,
+};
+
+typedef struct stream_slot_t {
+    char    *data;
+    int64_t  end;     /* stream position right after the slot was sent */
+} stream_slot_t;
+
+typedef struct sink_stream_t {
+    int           mode;
+    int           is_socket;
+    int64_t       pipe_size;
+    int           pipe_fds[2];
+    char         *zeros;
+    stream_slot_t slots[STREAM_RING_SLOTS];
+    int           next_slot;
+    int64_t       position;  /* file offset reached */
+    int64_t       sent;      /* bytes sent, holes skipped with --skip-holes excluded */
+} sink_stream_t;
+
+/* bytes sent but not taken by the reader yet */
+static int64_t stream_pending(sink_t *sink)
+{
+    sink_stream_t *stream = sink->priv;
+    int            queued = 0;
+
+    if (stream->mode == STREAM_MODE_VMSPLICE) {
+        if (ioctl(sink->fd, FIONREAD, &queued))
+            return 0;
+    }
+    else if (stream->is_socket) {
+        if (ioctl(sink->fd, SIOCOUTQ, &queued))
+            return 0;
+    }
+
+    return queued;
+}
+
+/* wait until the reader has taken everything up to stream position <end> */
+static int stream_wait_consumed(sink_t *sink, int64_t end)
+{
+    sink_stream_t *stream = sink->priv;
+
+    while (stream->sent - stream_pending(sink) < end) {
+        struct pollfd pfd = { .fd = sink->fd, .events = 0 };
+        if (poll(&pfd, 1, STREAM_POLL_MS) > 0 && (pfd.revents & (POLLERR | POLLHUP))) {
+            errno = EPIPE;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int stream_splice_out(sink_t *sink, int64_t length)
+{
+    sink_stream_t *stream = sink->priv;
+
+    while (length > 0) {
+        ssize_t ret = splice(stream->pipe_fds[0], NULL, sink->fd, NULL, length, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        length -= ret;
+    }
+
+    return 0;
+}
+
+static int stream_write_full(int fd, const char *data, int64_t length)
+{
+    while (length > 0) {
+        ssize_t ret = write(fd, data, length);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data   += ret;
+        length -= ret;
+    }
+
+    return 0;
+}
+
+static int stream_send(sink_t *sink, const char *data, int64_t length)
+{
+    sink_stream_t *stream = sink->priv;
+    int            target = stream->mode == STREAM_MODE_VMSPLICE ? sink->fd : stream->pipe_fds[1];
+
+    while (length > 0) {
+        if (stream->mode == STREAM_MODE_WRITE) {
+            if (stream_write_full(sink->fd, data, length))
+                return -1;
+            stream->sent += length;
+            return 0;
+        }
+
+        /* nobody drains the private pipe while vmsplice() blocks on it */
+        int64_t      chunk = stream->mode == STREAM_MODE_SPLICE && length > stream->pipe_size ?
+                             stream->pipe_size : length;
+        struct iovec iov   = { .iov_base = (void *)data, .iov_len = chunk };
+        ssize_t ret = vmsplice(target, &iov, 1, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        if (stream->mode == STREAM_MODE_SPLICE && stream_splice_out(sink, ret)) {
+            if (errno != EINVAL || stream->sent > 0)
+                return -1;
+            /* the target does not take splice(), drain the private pipe by hand */
+            char    buf[4096];
+            ssize_t n;
+            for (ssize_t left = ret; left > 0; left -= n) {
+                n = read(stream->pipe_fds[0], buf, left < sizeof(buf) ? left : sizeof(buf));
+                if (n <= 0 || stream_write_full(sink->fd, buf, n))
+                    return -1;
+            }
+            stream->mode = STREAM_MODE_WRITE;
+        }
+
+        data         += ret;
+        length       -= ret;
+        stream->sent += ret;
+    }
+
+    return 0;
+}
+
+/* bring the stream to file offset <offset>: holes are zeros, or nothing with --skip-holes */
+static int stream_seek(sink_t *sink, int64_t offset)
+{
+    sink_stream_t *stream = sink->priv;
+
+    if (offset < stream->position) {
+        fprintf(stderr, "[ERROR]: the stream sink got offset %ld behind %ld\n", offset, stream->position);
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (!sink->param->skip_holes && stream->position < offset) {
+        int64_t length = offset - stream->position;
+        if (length > STREAM_ZERO_SIZE)
+            length = STREAM_ZERO_SIZE;
+        if (stream_send(sink, stream->zeros, length))
+            return -1;
+        stream->position += length;
+    }
+    stream->position = offset;
+
+    return 0;
+}
+
+static int sink_stream_num_buffers(param_t *param, int num_workers)
+{
+    return STREAM_RING_SLOTS;
+}
+
+static int sink_stream_open(sink_t *sink)
+{
+    sink_stream_t *stream = calloc(1, sizeof(sink_stream_t));
+    if (!stream)
+        return -1;
+    stream->pipe_fds[0] = -1;
+    stream->pipe_fds[1] = -1;
+    sink->priv = stream;
+
+    stream->zeros = alloc_aligned(STREAM_ZERO_SIZE, FUTIL_DIRECT_ALIGNMENT);
+    if (!stream->zeros)
+        return -1;
+
+    for (int i = 0 ; i < STREAM_RING_SLOTS; i++) {
+        stream->slots[i].data = alloc_aligned(sink->buffer_size, FUTIL_DIRECT_ALIGNMENT);
+        if (!stream->slots[i].data)
+            return -1;
+    }
+
+    sink->fd = dup(STDOUT_FILENO);
+    if (sink->fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(sink->fd, &st))
+        return -1;
+
+    if (S_ISFIFO(st.st_mode)) {
+        stream->mode = STREAM_MODE_VMSPLICE;
+        /* best effort, a larger pipe means fewer wake-ups of the reader */
+        fcntl(sink->fd, F_SETPIPE_SZ, STREAM_PIPE_SIZE);
+        return 0;
+    }
+
+    stream->is_socket = S_ISSOCK(st.st_mode);
+    if (pipe(stream->pipe_fds)) {
+        stream->mode = STREAM_MODE_WRITE;
+        return 0;
+    }
+    fcntl(stream->pipe_fds[1], F_SETPIPE_SZ, STREAM_PIPE_SIZE);
+    stream->pipe_size = fcntl(stream->pipe_fds[1], F_GETPIPE_SZ);
+    if (stream->pipe_size <= 0)
+        stream->pipe_size = getpagesize();
+    stream->mode = STREAM_MODE_SPLICE;
+
+    return 0;
+}
+
+static void *sink_stream_acquire(sink_t *sink, int worker, int64_t offset, int64_t length)
+{
+    sink_stream_t *stream = sink->priv;
+    stream_slot_t *slot   = &stream->slots[stream->next_slot];
+
+    if (stream_wait_consumed(sink, slot->end))
+        return NULL;
+    stream->next_slot = (stream->next_slot + 1) % STREAM_RING_SLOTS;
+
+    return slot->data;
+}
+
+static int sink_stream_write(sink_t *sink, int worker, const void *buf, int64_t offset, int64_t length)
+{
+    sink_stream_t *stream = sink->priv;
+
+    if (stream_seek(sink, offset))
+        return -1;
+    if (stream_send(sink, buf, length))
+        return -1;
+    stream->position += length;
+
+    return 0;
+}
+
+static int sink_stream_commit(sink_t *sink, int worker, void *buf, int64_t offset, int64_t length)
+{
+    sink_stream_t *stream = sink->priv;
+
+    if (sink_stream_write(sink, worker, buf, offset, length))
+        return -1;
+
+    for (int i = 0 ; i < STREAM_RING_SLOTS; i++) {
+        if (stream->slots[i].data == buf)
+            stream->slots[i].end = stream->sent;
+    }
+
+    return 0;
+}
+
+static int sink_stream_close(sink_t *sink, int64_t total_size)
+{
+    sink_stream_t *stream = sink->priv;
+    int            error  = 0;
+
+    if (!stream)
+        return sink_close_fd(sink, -1);
+
+    if (sink->fd >= 0 && total_size >= 0) {
+        /* trailing holes, then let the reader take every page before they are freed */
+        if (stream_seek(sink, total_size) || stream_wait_consumed(sink, stream->sent)) {
+            fprintf(stderr, "[ERROR]: failed to finish the stream: %s\n", strerror(errno));
+            error = -1;
+        }
+    }
+
+    for (int i = 0 ; i < 2; i++) {
+        if (stream->pipe_fds[i] >= 0)
+            close(stream->pipe_fds[i]);
+    }
+    for (int i = 0 ; i < STREAM_RING_SLOTS; i++)
+        free(stream->slots[i].data);
+    free(stream->zeros);
+    free(stream);
+    sink->priv = NULL;
+
+    if (sink_close_fd(sink, -1))
+        error = -1;
+
+    return error;
+}
+
+const sink_ops_t sink_stream_ops = {
+    .name        = "stream",
+    .open        = sink_stream_open,
+    .acquire     = sink_stream_acquire,
+    .commit      = sink_stream_commit,
+    .write       = sink_stream_write,
+    .close       = sink_stream_close,
+    .num_buffers = sink_stream_num_buffers,
+};
\ No newline at end of file
@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "stats.h"
+#include "futil.h"
+#include "utils.h"
+
+#define STATS_CACHE_LINE 64
+/* an interval writing less than this percentage of what was due is short */
+#define STATS_RATE_TOLERANCE 98
+
+#define STATS_LOAD(field)       __atomic_load_n(&(field), __ATOMIC_RELAXED)
+/* only the owning worker writes its counters, so a plain add is enough */
+#define STATS_ADD(field, value) __atomic_store_n(&(field), (field) + (value), __ATOMIC_RELAXED)
+
+static const char *stats_phase_names[] = {
+    [STATS_PHASE_GENERATE]   = "generate",
+    [STATS_PHASE_WRITE]      = "write",
+    [STATS_PHASE_SYNC]       = "sync",
+    [STATS_PHASE_PREALLOC]   = "prealloc",
+    [STATS_PHASE_DROP_CACHE] = "drop_cache",
+};
+
+typedef struct stats_counters_t {
+    uint64_t bytes;
+    uint64_t chunks;
+    uint64_t time[STATS_PHASE_LAST];
+    uint64_t writes;
+    uint64_t max_latency;
+    uint64_t latency[STATS_LATENCY_BUCKETS];
+} __attribute__((aligned(STATS_CACHE_LINE))) stats_counters_t;
+
+struct stats_t {
+    param_t          *param;
+    int               num_workers;
+    stats_counters_t *workers;
+    uint64_t          start;
+    uint64_t          end;
+    int64_t           size;     /* bytes to write, 0 when only --duration ends the run */
+
+    rate_t           *rate;
+    int64_t           intervals;
+    int64_t           short_intervals;
+    double            worst_shortfall;  /* bytes per second below the target */
+
+    int               interval_ms;
+    int               reporting;
+    int               stop;
+    pthread_t         reporter;
+    pthread_mutex_t   lock;
+    pthread_cond_t    cond;
+};
+
+/* a JSON string, escaping what a file name may contain */
+static void json_string(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fprintf(fp, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(fp, "\\u%04x", *c);
+        else
+            fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+static void stats_sum(stats_t *stats, stats_counters_t *total)
+{
+    memset(total, 0, sizeof(*total));
+
+    for (int i = 0 ; i < stats->num_workers; i++) {
+        stats_counters_t *w = &stats->workers[i];
+
+        total->bytes  += STATS_LOAD(w->bytes);
+        total->chunks += STATS_LOAD(w->chunks);
+        total->writes += STATS_LOAD(w->writes);
+        for (int p = 0 ; p < STATS_PHASE_LAST; p++)
+            total->time[p] += STATS_LOAD(w->time[p]);
+        for (int b = 0 ; b < STATS_LATENCY_BUCKETS; b++)
+            total->latency[b] += STATS_LOAD(w->latency[b]);
+
+        uint64_t max = STATS_LOAD(w->max_latency);
+        if (max > total->max_latency)
+            total->max_latency = max;
+    }
+}
+
+/* upper bound of the bucket holding the <pct> percentile, at most the maximum */
+static uint64_t stats_percentile(stats_counters_t *total, int pct)
+{
+    uint64_t rank = (total->writes * pct + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int b = 0 ; b < STATS_LATENCY_BUCKETS; b++) {
+        seen += total->latency[b];
+        if (seen >= rank && seen > 0) {
+            uint64_t bound = 1ULL << (b + 1);
+            return bound < total->max_latency ? bound : total->max_latency;
+        }
+    }
+    return 0;
+}
+
+static double stats_percent(stats_counters_t *total, int phase)
+{
+    uint64_t busy = 0;
+    for (int p = 0 ; p < STATS_PHASE_LAST; p++)
+        busy += total->time[p];
+    return busy ? 100.0 * total->time[phase] / busy : 0.0;
+}
+
+/* wall time of the workers: the run, less what the main thread spent before and after them */
+static double stats_write_phase(stats_t *stats, stats_counters_t *total, double elapsed)
+{
+    double main = (total->time[STATS_PHASE_PREALLOC] + total->time[STATS_PHASE_SYNC] +
+                   total->time[STATS_PHASE_DROP_CACHE]) / 1e9;
+
+    return elapsed > main ? elapsed - main : 0.0;
+}
+
+static void *stats_reporter_main(void *arg)
+{
+    stats_t         *stats      = arg;
+    uint64_t         last_time  = stats->start;
+    uint64_t         last_bytes = 0;
+    uint64_t         last_chunk = 0;
+    stats_counters_t total;
+
+    pthread_mutex_lock(&stats->lock);
+    while (!stats->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += stats->interval_ms / 1000;
+        deadline.tv_nsec += (stats->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (pthread_cond_timedwait(&stats->cond, &stats->lock, &deadline) != ETIMEDOUT || stats->stop)
+            continue;
+
+        stats_sum(stats, &total);
+
+        uint64_t now     = stats_now();
+        double   delta   = (now - last_time) / 1e9;
+        double   elapsed = (now - stats->start) / 1e9;
+        int64_t  size    = stats->size;
+        double   rate    = elapsed > 0 ? total.bytes / elapsed : 0;
+        double   eta     = rate > 0 && size > total.bytes ? (size - total.bytes) / rate : 0;
+        char    *done    = bytes_to_unit(total.bytes, UNIT_FORMAT_NORMAL);
+        char    *all     = bytes_to_unit(size, UNIT_FORMAT_NORMAL);
+        char     pace[128] = "";
+
+        if (size <= 0 && stats->param->duration > elapsed)
+            eta = stats->param->duration - elapsed;
+
+        /* what the interval wrote against what the rate profile made due in it */
+        double due = rate_due(stats->rate, now) - rate_due(stats->rate, last_time);
+        if (due > 0 && delta > 0) {
+            double wrote = total.bytes - last_bytes;
+            double below = due > wrote ? (due - wrote) / delta : 0;
+            stats->intervals++;
+            if (wrote * 100 < due * STATS_RATE_TOLERANCE)
+                stats->short_intervals++;
+            if (below > stats->worst_shortfall)
+                stats->worst_shortfall = below;
+            snprintf(pace, sizeof(pace), " (target %.2f MB/s, short %.2f MB/s)",
+                due / 1048576.0 / delta, below / 1048576.0);
+        }
+
+        if (size > 0)
+            fprintf(stdout, "[INFO ]: %s of %s (%.1f%%), ", done, all, 100.0 * total.bytes / size);
+        else
+            fprintf(stdout, "[INFO ]: %s written, ", done);
+        fprintf(stdout, "%.2f MB/s%s, %.0f chunks/s, ETA %.0f s, generate %.0f%% / write %.0f%% / sync %.0f%%\n",
+            delta > 0 ? (total.bytes - last_bytes) / 1048576.0 / delta : 0.0, pace,
+            delta > 0 ? (total.chunks - last_chunk) / delta : 0.0, eta,
+            stats_percent(&total, STATS_PHASE_GENERATE), stats_percent(&total, STATS_PHASE_WRITE),
+            stats_percent(&total, STATS_PHASE_SYNC));
+        fflush(stdout);
+
+        free(done);
+        free(all);
+        last_time  = now;
+        last_bytes = total.bytes;
+        last_chunk = total.chunks;
+    }
+    pthread_mutex_unlock(&stats->lock);
+
+    return NULL;
+}
+
+stats_t *stats_create(param_t *param, int num_workers, int interval_ms)
+{
+    if (!param || num_workers <= 0 || interval_ms < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    stats_t *stats = calloc(1, sizeof(stats_t));
+    if (!stats)
+        return NULL;
+
+    stats->param       = param;
+    stats->num_workers = num_workers;
+    stats->interval_ms = interval_ms;
+    /* every pass of --loop, none known in advance when --duration alone ends the run */
+    if (param->loops > 0)
+        stats->size = param->filesize * param->loops;
+    else if (param->duration <= 0)
+        stats->size = param->filesize;
+    stats->workers     = alloc_aligned(num_workers * sizeof(stats_counters_t), STATS_CACHE_LINE);
+    if (!stats->workers) {
+        free(stats);
+        return NULL;
+    }
+    pthread_mutex_init(&stats->lock, NULL);
+    pthread_cond_init(&stats->cond, NULL);
+    stats->start = stats_now();
+
+    if (interval_ms > 0) {
+        if (pthread_create(&stats->reporter, NULL, stats_reporter_main, stats))
+            fprintf(stderr, "[WARN ]: failed to start the progress reporter\n");
+        else
+            stats->reporting = 1;
+    }
+
+    return stats;
+}
+
+void stats_set_rate(stats_t *stats, rate_t *rate)
+{
+    if (!stats)
+        return;
+
+    pthread_mutex_lock(&stats->lock);
+    stats->rate = rate;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_add_data(stats_t *stats, int worker, int64_t bytes, int64_t chunks)
+{
+    if (!stats)
+        return;
+
+    stats_counters_t *w = &stats->workers[worker];
+    STATS_ADD(w->bytes, bytes);
+    STATS_ADD(w->chunks, chunks);
+}
+
+void stats_add_time(stats_t *stats, int worker, int phase, uint64_t ns)
+{
+    if (!stats)
+        return;
+
+    STATS_ADD(stats->workers[worker].time[phase], ns);
+}
+
+void stats_add_write(stats_t *stats, int worker, uint64_t ns)
+{
+    if (!stats)
+        return;
+
+    stats_counters_t *w      = &stats->workers[worker];
+    int               bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (bucket >= STATS_LATENCY_BUCKETS)
+        bucket = STATS_LATENCY_BUCKETS - 1;
+
+    STATS_ADD(w->time[STATS_PHASE_WRITE], ns);
+    STATS_ADD(w->writes, 1);
+    STATS_ADD(w->latency[bucket], 1);
+    if (ns > w->max_latency)
+        __atomic_store_n(&w->max_latency, ns, __ATOMIC_RELAXED);
+}
+
+/* stop the reporter and freeze the elapsed time */
+void stats_finish(stats_t *stats)
+{
+    if (!stats)
+        return;
+
+    if (stats->reporting) {
+        pthread_mutex_lock(&stats->lock);
+        stats->stop = 1;
+        pthread_cond_signal(&stats->cond);
+        pthread_mutex_unlock(&stats->lock);
+        pthread_join(stats->reporter, NULL);
+        stats->reporting = 0;
+    }
+
+    if (!stats->end)
+        stats->end = stats_now();
+}
+
+void stats_print(stats_t *stats)
+{
+    if (!stats)
+        return;
+
+    stats_counters_t total;
+    stats_sum(stats, &total);
+
+    double elapsed = ((stats->end ? stats->end : stats_now()) - stats->start) / 1e9;
+    char  *bytes   = bytes_to_unit(total.bytes, UNIT_FORMAT_NORMAL);
+
+    fprintf(stdout, "[INFO ]: wrote %s in %.2f s, %.2f MB/s, %.0f chunks/s\n", bytes, elapsed,
+        elapsed > 0 ? total.bytes / 1048576.0 / elapsed : 0.0, elapsed > 0 ? total.chunks / elapsed : 0.0);
+    fprintf(stdout, "[INFO ]: worker time: generate %.2f s, write %.2f s, sync %.2f s\n",
+        total.time[STATS_PHASE_GENERATE] / 1e9, total.time[STATS_PHASE_WRITE] / 1e9,
+        total.time[STATS_PHASE_SYNC] / 1e9);
+    /* the workers run in between what the main thread does before and after them */
+    fprintf(stdout, "[INFO ]: phases: prealloc %.2f s, generate and write %.2f s, sync %.2f s, drop cache %.2f s\n",
+        total.time[STATS_PHASE_PREALLOC] / 1e9, stats_write_phase(stats, &total, elapsed),
+        total.time[STATS_PHASE_SYNC] / 1e9, total.time[STATS_PHASE_DROP_CACHE] / 1e9);
+    if (total.writes > 0) {
+        fprintf(stdout, "[INFO ]: write latency: %lu writes, p50 < %lu us, p99 < %lu us, max %lu us\n",
+            total.writes, stats_percentile(&total, 50) / 1000, stats_percentile(&total, 99) / 1000,
+            total.max_latency / 1000);
+    }
+    if (stats->rate && stats->param->rate > 0) {
+        uint64_t end = stats->end ? stats->end : stats_now();
+        char    *lost = bytes_to_unit(rate_shortfall(stats->rate), UNIT_FORMAT_NORMAL);
+        fprintf(stdout, "[INFO ]: paced to %.2f MB/s on average, %ld of %ld intervals short, "
+                        "worst %.2f MB/s below, %s of credit lost\n",
+            elapsed > 0 ? rate_due(stats->rate, end) / 1048576.0 / elapsed : 0.0,
+            stats->short_intervals, stats->intervals, stats->worst_shortfall / 1048576.0, lost);
+        free(lost);
+    }
+
+    free(bytes);
+}
+
+int stats_write_json(stats_t *stats, const char *path)
+{
+    if (!stats || !path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "[ERROR]: failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    stats_counters_t total;
+    stats_sum(stats, &total);
+
+    param_t *param   = stats->param;
+    double   elapsed = ((stats->end ? stats->end : stats_now()) - stats->start) / 1e9;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"file\": ");
+    json_string(fp, param->filename);
+    fprintf(fp, ",\n");
+    fprintf(fp, "  \"size\": %ld,\n", param->filesize);
+    fprintf(fp, "  \"seed\": %llu,\n", (unsigned long long)param->seed);
+    fprintf(fp, "  \"threads\": %d,\n", stats->num_workers);
+    fprintf(fp, "  \"bytes\": %lu,\n", total.bytes);
+    fprintf(fp, "  \"chunks\": %lu,\n", total.chunks);
+    fprintf(fp, "  \"elapsed_s\": %.6f,\n", elapsed);
+    fprintf(fp, "  \"mb_per_s\": %.2f,\n", elapsed > 0 ? total.bytes / 1048576.0 / elapsed : 0.0);
+    fprintf(fp, "  \"chunks_per_s\": %.2f,\n", elapsed > 0 ? total.chunks / elapsed : 0.0);
+    if (stats->rate && param->rate > 0) {
+        uint64_t end = stats->end ? stats->end : stats_now();
+        fprintf(fp, "  \"rate\": { \"target_mb_per_s\": %.2f, \"intervals\": %ld, \"short_intervals\": %ld, "
+                    "\"worst_shortfall_mb_per_s\": %.2f, \"credit_lost\": %ld },\n",
+            elapsed > 0 ? rate_due(stats->rate, end) / 1048576.0 / elapsed : 0.0, stats->intervals,
+            stats->short_intervals, stats->worst_shortfall / 1048576.0, rate_shortfall(stats->rate));
+    }
+    fprintf(fp, "  \"worker_time_s\": {");
+    for (int p = 0 ; p < STATS_PHASE_LAST; p++)
+        fprintf(fp, "%s\"%s\": %.6f", p ? ", " : " ", stats_phase_names[p], total.time[p] / 1e9);
+    fprintf(fp, " },\n");
+    fprintf(fp, "  \"phases_s\": { \"prealloc\": %.6f, \"write\": %.6f, \"sync\": %.6f, \"drop_cache\": %.6f },\n",
+        total.time[STATS_PHASE_PREALLOC] / 1e9, stats_write_phase(stats, &total, elapsed),
+        total.time[STATS_PHASE_SYNC] / 1e9, total.time[STATS_PHASE_DROP_CACHE] / 1e9);
+    fprintf(fp, "  \"write_latency_ns\": {\n");
+    fprintf(fp, "    \"count\": %lu,\n", total.writes);
+    fprintf(fp, "    \"p50\": %lu,\n", stats_percentile(&total, 50));
+    fprintf(fp, "    \"p90\": %lu,\n", stats_percentile(&total, 90));
+    fprintf(fp, "    \"p99\": %lu,\n", stats_percentile(&total, 99));
+    fprintf(fp, "    \"max\": %lu,\n", total.max_latency);
+    fprintf(fp, "    \"histogram\": [");
+    int first = 1;
+    for (int b = 0 ; b < STATS_LATENCY_BUCKETS; b++) {
+        if (!total.latency[b])
+            continue;
+        fprintf(fp, "%s{ \"lt\": %llu, \"count\": %lu }", first ? " " : ", ", 1ULL << (b + 1), total.latency[b]);
+        first = 0;
+    }
+    fprintf(fp, " ]\n");
+    fprintf(fp, "  }\n");
+    fprintf(fp, "}\n");
+
+    if (fclose(fp)) {
+        fprintf(stderr, "[ERROR]: failed to write %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+void stats_destroy(stats_t *stats)
+{
+    if (!stats)
+        return;
+
+    stats_finish(stats);
+    pthread_mutex_destroy(&stats->lock);
+    pthread_cond_destroy(&stats->cond);
+    free(stats->workers);
+    free(stats);
+}
\ No newline at end of file
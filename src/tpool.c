@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include "tpool.h"
+
+typedef struct tpool_job_t {
+    tpool_fn_t  fn;
+    void       *arg;
+} tpool_job_t;
+
+typedef struct tpool_worker_t {
+    tpool_t    *pool;
+    int         index;
+    pthread_t   tid;
+} tpool_worker_t;
+
+struct tpool_t {
+    int             num_threads;
+    tpool_worker_t *workers;
+
+    tpool_job_t    *queue;
+    int             queue_depth;
+    int             head;
+    int             count;
+    int             running;
+    int             shutdown;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+    pthread_cond_t  idle;
+};
+
+static void *tpool_worker_main(void *arg)
+{
+    tpool_worker_t *worker = arg;
+    tpool_t        *pool   = worker->pool;
+    tpool_job_t     job;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->count == 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+
+        if (pool->count == 0 && pool->shutdown)
+            break;
+
+        job = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->queue_depth;
+        pool->count--;
+        pool->running++;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+
+        job.fn(job.arg, worker->index);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->running--;
+        if (pool->count == 0 && pool->running == 0)
+            pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+tpool_t *tpool_create(int num_threads, int queue_depth)
+{
+    tpool_t *pool = calloc(1, sizeof(tpool_t));
+    if (!pool)
+        return NULL;
+
+    pool->num_threads = num_threads > 1 ? num_threads : 0;
+    if (pool->num_threads == 0)
+        return pool;
+
+    pool->queue_depth = queue_depth > 0 ? queue_depth : 2 * num_threads;
+    pool->queue       = calloc(pool->queue_depth, sizeof(tpool_job_t));
+    pool->workers     = calloc(pool->num_threads, sizeof(tpool_worker_t));
+    if (!pool->queue || !pool->workers)
+        goto error;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (int i = 0 ; i < pool->num_threads; i++) {
+        pool->workers[i].pool  = pool;
+        pool->workers[i].index = i;
+        if (pthread_create(&pool->workers[i].tid, NULL, tpool_worker_main, &pool->workers[i])) {
+            pool->num_threads = i;
+            tpool_destroy(pool);
+            errno = EAGAIN;
+            return NULL;
+        }
+    }
+
+    return pool;
+
+error:
+    free(pool->queue);
+    free(pool->workers);
+    free(pool);
+    errno = ENOMEM;
+    return NULL;
+}
+
+int tpool_submit(tpool_t *pool, tpool_fn_t fn, void *arg)
+{
+    if (!pool || !fn) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (pool->num_threads == 0) {
+        fn(arg, 0);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count == pool->queue_depth)
+        pthread_cond_wait(&pool->not_full, &pool->lock);
+    int tail = (pool->head + pool->count) % pool->queue_depth;
+    pool->queue[tail].fn  = fn;
+    pool->queue[tail].arg = arg;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+void tpool_wait(tpool_t *pool)
+{
+    if (!pool || pool->num_threads == 0)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count > 0 || pool->running > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void tpool_destroy(tpool_t *pool)
+{
+    if (!pool)
+        return;
+
+    if (pool->num_threads > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pool->shutdown = 1;
+        pthread_cond_broadcast(&pool->not_empty);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int i = 0 ; i < pool->num_threads; i++)
+            pthread_join(pool->workers[i].tid, NULL);
+
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->not_empty);
+        pthread_cond_destroy(&pool->not_full);
+        pthread_cond_destroy(&pool->idle);
+    }
+
+    free(pool->queue);
+    free(pool->workers);
+    free(pool);
+}
+
+int tpool_num_workers(tpool_t *pool)
+{
+    if (!pool)
+        return 0;
+    return pool->num_threads > 0 ? pool->num_threads : 1;
+}
@@ -7,6 +7,7 @@
 #define BYTES_TO_KILOBYTES (1024LL)
 #define BYTES_TO_MEGABYTES (1048576LL)
 #define BYTES_TO_GIGABYTES (1073741824LL)
+#define BYTES_TO_TERABYTES (1099511627776LL)
 
 #define UNIT_FORMAT_NORMAL_PRECISION 2
 
@@ -17,38 +18,43 @@ static char *unit_format_normal(int64_t _bytes)
     char    buf[64];
 
     if (bytes < 0) {
-        bytes *=  1;
+        bytes *= -1;
         sign   = -1;
     }
 
+    const char *minus = sign == -1 ? "-" : "";
+
     int64_t prec = 1;
     for (int i = 0; i < UNIT_FORMAT_NORMAL_PRECISION; i++)
         prec *= 10;
 
     if (bytes < BYTES_TO_KILOBYTES) {
-        snprintf(buf, 64, "%ld bytes", bytes);
+        snprintf(buf, 64, "%s%ld bytes", minus, bytes);
     }
     else if (bytes < BYTES_TO_MEGABYTES) {
         int64_t val = bytes * prec / BYTES_TO_KILOBYTES;
         int64_t precision = val % prec;
         val /= prec;
-        snprintf(buf, 64, "%ld.%ld KB", val, precision);
+        snprintf(buf, 64, "%s%ld.%ld KB", minus, val, precision);
     }
     else if (bytes < BYTES_TO_GIGABYTES) {
         int64_t val = bytes * prec / BYTES_TO_MEGABYTES;
         int64_t precision = val % prec;
         val /= prec;
-        snprintf(buf, 64, "%ld.%ld MB", val, precision);
+        snprintf(buf, 64, "%s%ld.%ld MB", minus, val, precision);
     }
-    else {
-        int64_t val = bytes * prec / BYTES_TO_GIGABYTES;
+    else if (bytes < BYTES_TO_TERABYTES) {
+        int64_t val = bytes / (BYTES_TO_GIGABYTES / prec);
         int64_t precison = val % prec;
         val /= prec;
-        snprintf(buf, 64, "%ld.%ld GB", val, precison);
+        snprintf(buf, 64, "%s%ld.%ld GB", minus, val, precison);
     }
-
-    if (sign == -1) {
-        snprintf(buf, 64, "-%s", buf);
+    else {
+        /* bytes * prec would overflow past 80 PB */
+        int64_t val = bytes / (BYTES_TO_TERABYTES / prec);
+        int64_t precison = val % prec;
+        val /= prec;
+        snprintf(buf, 64, "%s%ld.%ld TB", minus, val, precison);
     }
 
     return strdup(buf);
@@ -103,9 +109,12 @@ int64_t unit_to_bytes(const char *str)
     }
 
     int64_t num    = 0;
-    char buf[8];
+    char buf[8]    = "";
 
-    sscanf(str, "%ld%s", &num, buf);
+    if (sscanf(str, "%ld%7s", &num, buf) < 1) {
+        fprintf(stderr, "invalid size: %s\n", str);
+        return -1;
+    }
 
     if (strcmp(buf, "")  == 0 ||
         strcmp(buf, "B") == 0 ||
@@ -130,6 +139,12 @@ int64_t unit_to_bytes(const char *str)
         strcmp(buf, "G")  == 0) {
         return num * BYTES_TO_GIGABYTES;
     }
+    else if (strcmp(buf, "TB") == 0 ||
+        strcmp(buf, "tb") == 0 ||
+        strcmp(buf, "t")  == 0 ||
+        strcmp(buf, "T")  == 0) {
+        return num * BYTES_TO_TERABYTES;
+    }
     else {
         fprintf(stderr, "unsupported unit\n");
         return -1;